@@ -0,0 +1,85 @@
+#include "BranchInfo.h"
+
+#include "llvm/IR/DebugInfoMetadata.h"
+
+#include <set>
+
+using namespace llvm;
+
+AnalysisKey BranchInfoAnalysis::Key;
+
+BranchIdScheme BranchIds = BranchIdScheme::Hash;
+
+namespace {
+
+void HashBytes(uint32_t &hash, StringRef bytes) {
+    for (unsigned char byte : bytes.bytes()) {
+        hash = (hash ^ byte) * 16777619u;
+    }
+    // Keep ("ab", "c") and ("a", "bc") apart.
+    hash = (hash ^ 0xff) * 16777619u;
+}
+
+// 32-bit FNV-1a over the edge's source position, cut to 31 bits so ids stay
+// positive ints. 0 is reserved for LogPointer records in binary traces.
+int HashBranchId(StringRef file, StringRef function, unsigned int line,
+                 unsigned int column, unsigned int successor_index) {
+    uint32_t hash = 2166136261u;
+    HashBytes(hash, file);
+    HashBytes(hash, function);
+    HashBytes(hash, std::to_string(line));
+    HashBytes(hash, std::to_string(column));
+    HashBytes(hash, std::to_string(successor_index));
+    return hash & 0x7fffffff;
+}
+
+}
+
+BranchInfoAnalysis::Result BranchInfoAnalysis::run(Module &M, ModuleAnalysisManager &AM) {
+    Result branches;
+    int branch_id_counter = 1;
+    // Ids already taken in this module. Edges that hash to the same id (say,
+    // from the same macro expansion) probe forward in module order.
+    std::set<int> used_ids;
+
+    for (auto &F : M.functions()) {
+        for (auto &B : F) {
+            auto *branch_instruction = dyn_cast_or_null<BranchInst>(B.getTerminator());
+            if (!branch_instruction || !branch_instruction->isConditional()) continue;
+
+            DILocation *source_location = branch_instruction->getDebugLoc();
+            if (!source_location) continue;
+
+            std::string source_file_name = source_location->getFilename().str();
+            unsigned int source_line_number = source_location->getLine();
+
+            for (unsigned int ii = 0; ii < branch_instruction->getNumSuccessors(); ++ii) {
+                BasicBlock *successor = branch_instruction->getSuccessor(ii);
+                if (!successor || successor->empty()) continue;
+
+                DILocation *successor_location = successor->front().getDebugLoc();
+                if (!successor_location) continue;
+
+                int branch_id = branch_id_counter++;
+                if (BranchIds == BranchIdScheme::Hash) {
+                    branch_id = HashBranchId(source_file_name, F.getName(), source_line_number,
+                                             source_location->getColumn(), ii);
+                    while (branch_id == 0 || !used_ids.insert(branch_id).second) {
+                        branch_id = (branch_id + 1) & 0x7fffffff;
+                    }
+                }
+
+                branches.push_back({source_file_name, branch_id, source_line_number,
+                                    successor_location->getLine(), branch_instruction, ii});
+            }
+        }
+    }
+
+    return branches;
+}
+
+void registerBranchInfoAnalysis(PassBuilder &PB) {
+    PB.registerAnalysisRegistrationCallback([](ModuleAnalysisManager &MAM) {
+        MAM.registerPass([] { return BranchInfoAnalysis(); });
+    });
+}
@@ -0,0 +1,50 @@
+#ifndef BRANCH_INFO_H
+#define BRANCH_INFO_H
+
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/Passes/PassBuilder.h"
+
+#include <string>
+#include <vector>
+
+// One conditional branch edge: successor `successor_index` of `branch` is
+// br_<branch_id>, going from src_lno to dest_lno in filepath.
+struct BranchInfo {
+    std::string filepath;
+    int branch_id;
+    unsigned int src_lno;
+    unsigned int dest_lno;
+    llvm::BranchInst *branch;
+    unsigned int successor_index;
+};
+
+enum class BranchIdScheme { Hash, Sequential };
+
+// How BranchInfoAnalysis assigns ids. Hash (the default) derives each id from
+// file, function, line, column and successor, so ids stay the same across
+// translation units and rebuilds. Sequential numbers edges from 1 per module.
+// SkeletonPass exposes this as -branch-ids.
+extern BranchIdScheme BranchIds;
+
+// Numbers the conditional branch edges of a module. SkeletonPass instruments
+// them and SeminalPass analyzes their source lines, both from the same cached
+// table, so neither has to go through branch_info.txt.
+class BranchInfoAnalysis : public llvm::AnalysisInfoMixin<BranchInfoAnalysis> {
+public:
+    using Result = std::vector<BranchInfo>;
+
+    Result run(llvm::Module &M, llvm::ModuleAnalysisManager &AM);
+
+private:
+    friend llvm::AnalysisInfoMixin<BranchInfoAnalysis>;
+    static llvm::AnalysisKey Key;
+};
+
+// Registration entry points, used by the single pass plugins and by the
+// combined BranchPasses plugin.
+void registerBranchInfoAnalysis(llvm::PassBuilder &PB);
+void registerSkeletonPass(llvm::PassBuilder &PB);
+void registerSeminalPass(llvm::PassBuilder &PB);
+
+#endif
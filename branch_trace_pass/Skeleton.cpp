@@ -1,11 +1,20 @@
+#include "BranchInfo.h"
+#include "trace_format.h"
+
 #include "llvm/Pass.h"
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Passes/PassPlugin.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/BranchProbabilityInfo.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
 #include <fstream>
 #include <map>
+#include <set>
 #include <vector>
 #include <string>
 
@@ -13,14 +22,53 @@ using namespace llvm;
 
 namespace {
 
-
-struct BranchInfo {
-    std::string filepath;
-    int branch_id;
-    unsigned int src_lno;
-    unsigned int dest_lno;
-};
-std::vector<BranchInfo> branchInfos;
+enum class InstrumentMode { Trace, Counters, Paths };
+
+cl::opt<InstrumentMode> Mode("skeleton-mode",
+    cl::desc("How SkeletonPass records executed branches"),
+    cl::values(
+        clEnumValN(InstrumentMode::Trace, "trace", "call LogBranch on every branch edge (default)"),
+        clEnumValN(InstrumentMode::Counters, "counters", "increment an inline per-branch hit counter"),
+        clEnumValN(InstrumentMode::Paths, "paths", "count Ball-Larus acyclic paths per function")),
+    cl::init(InstrumentMode::Trace));
+
+cl::opt<unsigned int> MaxPaths("skeleton-max-paths",
+    cl::desc("Functions with more acyclic paths than this are not path profiled"),
+    cl::init(4096));
+
+enum class CounterPlacement { AllEdges, SpanningTree };
+
+cl::opt<CounterPlacement> Placement("skeleton-counter-placement",
+    cl::desc("Which edges get a counter in counters mode"),
+    cl::values(
+        clEnumValN(CounterPlacement::AllEdges, "all", "one counter per branch edge (default)"),
+        clEnumValN(CounterPlacement::SpanningTree, "spanning-tree", "only edges off a maximum spanning tree of the CFG")),
+    cl::init(CounterPlacement::AllEdges));
+
+cl::opt<bool> AtomicCounters("skeleton-atomic-counters",
+    cl::desc("Use relaxed atomic increments in counters mode (for threaded programs)"),
+    cl::init(false));
+
+enum class BranchSelection { All, Seminal, NonSeminal };
+
+cl::opt<BranchSelection> Select("skeleton-select",
+    cl::desc("Which branches SkeletonPass instruments, from SeminalPass results"),
+    cl::values(
+        clEnumValN(BranchSelection::All, "all", "every conditional branch (default)"),
+        clEnumValN(BranchSelection::Seminal, "seminal", "only branches SeminalPass found input dependent"),
+        clEnumValN(BranchSelection::NonSeminal, "non-seminal", "only branches that are not input dependent")),
+    cl::init(BranchSelection::All));
+
+cl::opt<std::string> BranchInfoFile("branch-info-file",
+    cl::desc("Also export the branch table as text to this file"),
+    cl::init(""));
+
+cl::opt<BranchIdScheme, true> BranchIdOption("branch-ids",
+    cl::desc("How branch ids are assigned"),
+    cl::values(
+        clEnumValN(BranchIdScheme::Hash, "hash", "stable hash of the branch's source position (default)"),
+        clEnumValN(BranchIdScheme::Sequential, "sequential", "1, 2, 3, ... in module order")),
+    cl::location(BranchIds));
 
 FunctionCallee CreateBranchFunction(Function &F) {
     LLVMContext &func_context = F.getContext();
@@ -51,64 +99,645 @@ FunctionCallee CreatePointerFunction(Function &F) {
 }
 
 
+// One instrumented edge: successor `successor_index` of `branch` is br_<branch_id>.
+struct BranchEdge {
+    BranchInst *branch;
+    unsigned int successor_index;
+    int branch_id;
+};
+
+// Creates an internal void() function that calls `callee` with `args`, and
+// registers it as a global constructor or destructor.
+void CreateCounterHook(Module &M, StringRef name, StringRef callee, ArrayRef<Constant*> args, bool destructor) {
+    LLVMContext &context = M.getContext();
+    std::vector<Type*> parameters;
+    for (Constant *arg : args) {
+        parameters.push_back(arg->getType());
+    }
+
+    FunctionType *callee_type = FunctionType::get(Type::getVoidTy(context), parameters, false);
+    FunctionType *hook_type = FunctionType::get(Type::getVoidTy(context), false);
+    Function *hook = Function::Create(hook_type, GlobalValue::InternalLinkage, name, M);
+
+    IRBuilder<> Builder(BasicBlock::Create(context, "entry", hook));
+    Builder.CreateCall(M.getOrInsertFunction(callee, callee_type), std::vector<Value*>(args.begin(), args.end()));
+    Builder.CreateRetVoid();
+
+    if (destructor)
+        appendToGlobalDtors(M, hook, 65535);
+    else
+        appendToGlobalCtors(M, hook, 65535);
+}
+
+// Pointer to the first element of a constant table.
+Constant *TableStart(GlobalVariable *table) {
+    Constant *zero = ConstantInt::get(Type::getInt32Ty(table->getContext()), 0);
+    return ConstantExpr::getInBoundsGetElementPtr(table->getValueType(), table, ArrayRef<Constant*>{zero, zero});
+}
+
+GlobalVariable *CreateInt32Table(Module &M, StringRef name, const std::vector<int> &values) {
+    Type *int_type = Type::getInt32Ty(M.getContext());
+    std::vector<Constant*> elements;
+    for (int value : values) {
+        elements.push_back(ConstantInt::get(int_type, value));
+    }
+    ArrayType *table_type = ArrayType::get(int_type, elements.size());
+    return new GlobalVariable(M, table_type, true, GlobalValue::InternalLinkage,
+                              ConstantArray::get(table_type, elements), name);
+}
+
+// Where code that counts the edge from `terminator` to its successor
+// `successor_index` goes: the start of the successor if this is its only
+// incoming edge, the end of the source if it is the only outgoing one, and
+// otherwise a new block split into the edge.
+Instruction *EdgeInsertionPoint(Instruction *terminator, unsigned int successor_index) {
+    BasicBlock *successor = terminator->getSuccessor(successor_index);
+    if (successor->hasNPredecessors(1))
+        return &*successor->getFirstInsertionPt();
+    if (terminator->getNumSuccessors() == 1)
+        return terminator;
+
+    BasicBlock *block = SplitCriticalEdge(terminator, successor_index);
+    if (!block) block = successor;
+    return &*block->getFirstInsertionPt();
+}
+
+// Adds one to counters[index], atomically with -skeleton-atomic-counters.
+void CreateCounterIncrement(IRBuilder<> &Builder, GlobalVariable *counters, Value *index) {
+    Type *counter_type = Type::getInt64Ty(counters->getContext());
+    Value *zero = ConstantInt::get(index->getType(), 0);
+    Value *counter = Builder.CreateInBoundsGEP(counters->getValueType(), counters, {zero, index});
+    Constant *one = ConstantInt::get(counter_type, 1);
+
+    if (AtomicCounters) {
+        Builder.CreateAtomicRMW(AtomicRMWInst::Add, counter, one, MaybeAlign(8), AtomicOrdering::Monotonic);
+    } else {
+        Value *count = Builder.CreateLoad(counter_type, counter);
+        Builder.CreateStore(Builder.CreateAdd(count, one), counter);
+    }
+}
+
+// The spanning tree and path placements only understand plain branches,
+// switches and function exits.
+bool HasSimpleTerminators(Function &F) {
+    for (auto &B : F) {
+        Instruction *terminator = B.getTerminator();
+        if (!terminator) return false;
+        if (!isa<BranchInst>(terminator) && !isa<SwitchInst>(terminator) &&
+            !isa<ReturnInst>(terminator) && !isa<UnreachableInst>(terminator)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Where one counter slot is incremented: on an edge of `terminator`, or for
+// the virtual edges of the spanning tree at the start of `block` (or right
+// before its terminator when `at_end` is set).
+struct CounterSite {
+    Instruction *terminator;
+    unsigned int successor_index;
+    BasicBlock *block;
+    int slot;
+    bool at_end = false;
+};
+
+// Edge of a function's CFG for spanning tree placement. Node 0 is a virtual
+// node that every exit block flows into and that flows into the entry block,
+// so flow is conserved at every node. Blocks are nodes 1..n. Like gcov, a
+// block with a call that may not return also gets a fake edge to node 0, so
+// frames still on the stack when exit() runs close their flow there.
+struct GraphEdge {
+    int src;
+    int dst;
+    Instruction *terminator;
+    unsigned int successor_index;
+    uint64_t weight;
+    int slot;
+};
+
+// Per-function slice of the graph tables, mirrors branch_counter_function in logger.c.
+struct GraphFunction {
+    int num_nodes;
+    int first_edge;
+    int num_edges;
+};
+
+// Edge of the acyclic graph used for Ball-Larus numbering. Node 0 is the
+// virtual exit, blocks are nodes 1..n with the entry block as node 1. A loop
+// back edge v->w is replaced by a BackExit edge v->0 and a BackEntry edge 1->w.
+enum class PathEdgeKind { Real, Exit, BackExit, BackEntry };
+
+struct PathEdge {
+    int src;
+    int dst;
+    PathEdgeKind kind;
+    Instruction *terminator;
+    unsigned int successor_index;
+    int value;
+    int branch_id;
+};
+
+// Per-function slice of the path tables, mirrors branch_path_function in logger.c.
+struct PathFunction {
+    Function *function;
+    int first_edge;
+    int num_edges;
+    int first_counter;
+    int num_paths;
+};
+// Packs the branch table into the __branch_info section of the object, see
+// trace_format.h for the layout. Strings are deduplicated per object.
+void EmitBranchInfoSection(Module &M, const std::vector<BranchInfo> &branchInfos,
+                           const std::vector<bool> &instrumented) {
+    if (branchInfos.empty()) return;
+
+    LLVMContext &context = M.getContext();
+    Type *int_type = Type::getInt32Ty(context);
+
+    std::string strings;
+    std::map<std::string, int> string_offsets;
+    auto intern = [&](const std::string &value) {
+        auto inserted = string_offsets.insert({value, strings.size()});
+        if (inserted.second) strings.append(value).push_back('\0');
+        return inserted.first->second;
+    };
+
+    std::vector<int> fields;
+    for (unsigned int i = 0; i < branchInfos.size(); ++i) {
+        const BranchInfo &branch = branchInfos[i];
+        fields.insert(fields.end(), {
+            branch.branch_id,
+            intern(branch.filepath),
+            intern(branch.branch->getFunction()->getName().str()),
+            (int)branch.src_lno,
+            (int)branch.dest_lno,
+            instrumented[i] ? 0 : BRANCH_INFO_UNINSTRUMENTED,
+        });
+    }
+    strings.resize(alignTo(strings.size(), 8), '\0');
+
+    std::vector<Constant*> records;
+    for (int value : fields) {
+        records.push_back(ConstantInt::get(int_type, value));
+    }
+    ArrayType *records_type = ArrayType::get(int_type, records.size());
+    Constant *strings_data = ConstantDataArray::getString(context, strings, false);
+
+    uint32_t size = sizeof(branch_info_header) + fields.size() * sizeof(uint32_t) + strings.size();
+    Constant *header[] = {
+        ConstantDataArray::getString(context, StringRef(BRANCH_INFO_MAGIC, 8), false),
+        ConstantInt::get(int_type, BRANCH_INFO_VERSION),
+        ConstantInt::get(int_type, sizeof(branch_info_record)),
+        ConstantInt::get(int_type, branchInfos.size()),
+        ConstantInt::get(int_type, size),
+        ConstantArray::get(records_type, records),
+        strings_data,
+    };
+    Constant *blob = ConstantStruct::getAnon(context, header);
+
+    GlobalVariable *table = new GlobalVariable(M, blob->getType(), true, GlobalValue::PrivateLinkage, blob, "__branch_info_table");
+    table->setSection(BRANCH_INFO_SECTION);
+    table->setAlignment(Align(8));
+    appendToUsed(M, {table});
+}
+
 struct SkeletonPass : public PassInfoMixin<SkeletonPass> {
-    PreservedAnalyses run(Module &M, ModuleAnalysisManager &AM) {
 
-        int branch_id_counter = 1;
-        std::ofstream file("branch_info.txt", std::ios::out | std::ios::trunc);
-        for (auto &F : M.functions()) {
+    void instrumentTrace(Module &M, std::vector<BranchEdge> &edges) {
+        for (auto &edge : edges) {
+            Function &F = *edge.branch->getFunction();
+            BasicBlock *successor = edge.branch->getSuccessor(edge.successor_index);
 
-            LLVMContext &func_context = F.getContext();
-            FunctionCallee branch_func_callee = CreateBranchFunction(F);
-            FunctionCallee pointer_func_callee = CreatePointerFunction(F);
+            IRBuilder<> Builder(F.getContext());
 
-            for(auto &B:F) {
-                for(auto & I:B) {
-                    
-                    auto *branch_instruction = dyn_cast<BranchInst>(&I);
+            Builder.SetInsertPoint(&(successor->front()));
+
+            Builder.CreateCall(CreateBranchFunction(F), {ConstantInt::get(Type::getInt32Ty(F.getContext()), edge.branch_id)});
+        }
+    }
+
+    // Knuth's placement: take a maximum spanning tree of the CFG (weighted by
+    // estimated edge frequency) and only count the edges outside of it. The
+    // tree edges are recovered from flow conservation when the counts are
+    // dumped. Appends the function's edges to `graph_edges`, its counters to
+    // `sites` and sets `edge_index` for every br_N edge of the function.
+    void placeOnSpanningTree(Function &F, FunctionAnalysisManager &FAM, std::vector<GraphEdge> &graph_edges,
+                             std::vector<CounterSite> &sites, std::map<std::pair<Instruction*, unsigned int>, int> &edge_index) {
+        BlockFrequencyInfo &BFI = FAM.getResult<BlockFrequencyAnalysis>(F);
+        BranchProbabilityInfo &BPI = FAM.getResult<BranchProbabilityAnalysis>(F);
+
+        std::map<BasicBlock*, int> node;
+        std::vector<BasicBlock*> blocks = {nullptr};
+        for (auto &B : F) {
+            node[&B] = blocks.size();
+            blocks.push_back(&B);
+        }
+
+        // Virtual edges get the highest weight so they always end up in the tree.
+        // The fake edges go first: they never run, so they must not get a
+        // counter, and with one per block they cannot close a cycle.
+        int first = graph_edges.size();
+        for (auto &B : F) {
+            for (auto &I : B) {
+                if (isa<CallBase>(I) && !I.willReturn()) {
+                    graph_edges.push_back({node[&B], 0, nullptr, 0, UINT64_MAX, -1});
+                    break;
+                }
+            }
+        }
+        graph_edges.push_back({0, node[&F.getEntryBlock()], nullptr, 0, UINT64_MAX, -1});
+        for (auto &B : F) {
+            Instruction *terminator = B.getTerminator();
+            if (terminator->getNumSuccessors() == 0) {
+                graph_edges.push_back({node[&B], 0, nullptr, 0, UINT64_MAX, -1});
+            }
+            for (unsigned int ii = 0; ii < terminator->getNumSuccessors(); ++ii) {
+                uint64_t weight = (BFI.getBlockFreq(&B) * BPI.getEdgeProbability(&B, ii)).getFrequency();
+                edge_index[{terminator, ii}] = graph_edges.size();
+                graph_edges.push_back({node[&B], node[terminator->getSuccessor(ii)], terminator, ii, weight, -1});
+            }
+        }
+
+        std::vector<int> order;
+        for (int e = first; e < (int)graph_edges.size(); ++e) order.push_back(e);
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+            return graph_edges[a].weight > graph_edges[b].weight;
+        });
+
+        std::vector<int> parent(blocks.size());
+        for (unsigned int n = 0; n < parent.size(); ++n) parent[n] = n;
+        auto find = [&](int n) {
+            while (parent[n] != n) n = parent[n] = parent[parent[n]];
+            return n;
+        };
+
+        for (int e : order) {
+            GraphEdge &edge = graph_edges[e];
+            int a = find(edge.src), b = find(edge.dst);
+            if (a != b) {
+                parent[a] = b;
+                continue;
+            }
+
+            edge.slot = sites.size();
+            if (edge.src == 0) {
+                sites.push_back({nullptr, 0, &F.getEntryBlock(), edge.slot});
+            } else if (edge.dst == 0) {
+                // Count returns at the end of the block, a call to exit() in
+                // it leaves through the fake edge instead.
+                sites.push_back({nullptr, 0, blocks[edge.src], edge.slot, true});
+            } else {
+                sites.push_back({edge.terminator, edge.successor_index, nullptr, edge.slot});
+            }
+        }
+    }
+
+    // Gives every counted edge a slot in a module-level counter array and
+    // bumps it inline. By default that is every br_N edge, with critical edges
+    // split so a slot counts exactly its own edge. The counts are written out
+    // by the logger runtime when the program exits.
+    void instrumentCounters(Module &M, std::vector<BranchEdge> &edges, ModuleAnalysisManager &AM) {
+        if (edges.empty()) return;
+
+        LLVMContext &context = M.getContext();
+        Type *counter_type = Type::getInt64Ty(context);
+        Type *int_type = Type::getInt32Ty(context);
+
+        std::vector<CounterSite> sites;
+        std::vector<int> ids;
+        std::vector<int> id_edges;
+        std::vector<GraphEdge> graph_edges;
+        std::vector<GraphFunction> graph_functions;
+
+        for (auto &edge : edges) {
+            ids.push_back(edge.branch_id);
+        }
+
+        if (Placement == CounterPlacement::SpanningTree) {
+            FunctionAnalysisManager &FAM = AM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+            std::map<std::pair<Instruction*, unsigned int>, int> edge_index;
+            id_edges.resize(edges.size());
+
+            unsigned int e = 0;
+            while (e < edges.size()) {
+                Function &F = *edges[e].branch->getFunction();
+                GraphFunction function = {1, (int)graph_edges.size(), 0};
 
-                    if(branch_instruction && branch_instruction->isConditional()) {
+                if (HasSimpleTerminators(F)) {
+                    function.num_nodes = F.size() + 1;
+                    placeOnSpanningTree(F, FAM, graph_edges, sites, edge_index);
+                }
 
-                        DILocation *source_location = branch_instruction->getDebugLoc(); //Maybe using I.getDebugLoc()
+                for (; e < edges.size() && edges[e].branch->getFunction() == &F; ++e) {
+                    auto found = edge_index.find({edges[e].branch, edges[e].successor_index});
+                    if (found != edge_index.end()) {
+                        id_edges[e] = found->second;
+                        continue;
+                    }
+                    // Fallback: a counted self loop on the single node.
+                    id_edges[e] = graph_edges.size();
+                    int slot = sites.size();
+                    graph_edges.push_back({0, 0, nullptr, 0, 0, slot});
+                    sites.push_back({edges[e].branch, edges[e].successor_index, nullptr, slot});
+                }
 
-                        if(source_location) {
+                function.num_edges = graph_edges.size() - function.first_edge;
+                graph_functions.push_back(function);
+            }
+        } else {
+            for (auto &edge : edges) {
+                sites.push_back({edge.branch, edge.successor_index, nullptr, (int)sites.size()});
+            }
+        }
 
-                            std::string source_file_name = source_location->getFilename().str();
+        ArrayType *counters_type = ArrayType::get(counter_type, std::max<size_t>(sites.size(), 1));
+        GlobalVariable *counters = new GlobalVariable(M, counters_type, false, GlobalValue::InternalLinkage,
+                                                      Constant::getNullValue(counters_type), "__branch_counters");
 
-                            unsigned int source_line_number = source_location->getLine();
+        for (auto &site : sites) {
+            Instruction *insert_before = site.terminator
+                ? EdgeInsertionPoint(site.terminator, site.successor_index)
+                : site.at_end ? site.block->getTerminator() : &*site.block->getFirstInsertionPt();
 
-                            for (unsigned int ii = 0; ii < branch_instruction->getNumSuccessors(); ++ii) {
-                                
-                                BasicBlock *successor = branch_instruction->getSuccessor(ii);
+            IRBuilder<> Builder(insert_before);
+            CreateCounterIncrement(Builder, counters, Builder.getInt32(site.slot));
+        }
 
-                                if(successor && !successor->empty()) {
+        GlobalVariable *id_table = CreateInt32Table(M, "__branch_counter_ids", ids);
+        Constant *open_args[] = {TableStart(counters), TableStart(id_table), ConstantInt::get(int_type, ids.size())};
+        CreateCounterHook(M, "__branch_counters_open", "BranchCountersOpen", open_args, false);
 
-                                    DILocation *successor_location = successor->front().getDebugLoc();
+        if (Placement != CounterPlacement::SpanningTree) {
+            CreateCounterHook(M, "__branch_counters_dump", "BranchCountersDump", open_args, true);
+            return;
+        }
+
+        // Describe the graphs for the runtime, see struct branch_counter_graph in logger.c.
+        std::vector<int> edge_fields, function_fields;
+        for (auto &edge : graph_edges) {
+            edge_fields.insert(edge_fields.end(), {edge.src, edge.dst, edge.slot});
+        }
+        for (auto &function : graph_functions) {
+            function_fields.insert(function_fields.end(), {function.num_nodes, function.first_edge, function.num_edges});
+        }
+
+        Type *int_ptr_type = Type::getInt32PtrTy(context);
+        StructType *graph_type = StructType::get(context, {int_ptr_type, int_ptr_type, int_type, int_type, int_ptr_type, int_ptr_type});
+        Constant *graph = ConstantStruct::get(graph_type, {
+            TableStart(id_table),
+            TableStart(CreateInt32Table(M, "__branch_counter_id_edges", id_edges)),
+            ConstantInt::get(int_type, ids.size()),
+            ConstantInt::get(int_type, graph_functions.size()),
+            TableStart(CreateInt32Table(M, "__branch_counter_functions", function_fields)),
+            TableStart(CreateInt32Table(M, "__branch_counter_edges", edge_fields)),
+        });
+        GlobalVariable *graph_table = new GlobalVariable(M, graph_type, true, GlobalValue::InternalLinkage, graph, "__branch_counter_graph");
+
+        Constant *dump_args[] = {TableStart(counters), graph_table};
+        CreateCounterHook(M, "__branch_counters_dump", "BranchCountersDumpGraph", dump_args, true);
+    }
+
+    // Builds the acyclic graph of F and assigns Ball-Larus edge values, so the
+    // sum of the values along any entry-to-exit path is a unique number in
+    // [0, num_paths). Returns false if F has more than -skeleton-max-paths paths.
+    bool numberPaths(Function &F, const std::map<std::pair<Instruction*, unsigned int>, int> &branch_ids,
+                     std::vector<PathEdge> &dag, int &num_paths) {
+        std::map<BasicBlock*, int> node;
+        std::vector<BasicBlock*> blocks = {nullptr};
+        for (auto &B : F) {
+            node[&B] = blocks.size();
+            blocks.push_back(&B);
+        }
+
+        auto branch_id = [&](Instruction *terminator, unsigned int ii) {
+            auto found = branch_ids.find({terminator, ii});
+            return found == branch_ids.end() ? 0 : found->second;
+        };
+
+        unsigned int first = dag.size();
+
+        // Depth-first search from the entry; an edge to a block that is still
+        // on the stack is a back edge.
+        std::vector<int> state(blocks.size(), 0);
+        std::vector<std::pair<int, unsigned int>> stack = {{1, 0}};
+        state[1] = 1;
+        while (!stack.empty()) {
+            int v = stack.back().first;
+            unsigned int ii = stack.back().second++;
+            Instruction *terminator = blocks[v]->getTerminator();
+
+            if (ii == 0 && terminator->getNumSuccessors() == 0) {
+                dag.push_back({v, 0, PathEdgeKind::Exit, terminator, 0, 0, 0});
+            }
+            if (ii >= terminator->getNumSuccessors()) {
+                state[v] = 2;
+                stack.pop_back();
+                continue;
+            }
 
-                                    if(successor_location) {
-                                        unsigned int target_line_number = successor_location->getLine();
+            int w = node[terminator->getSuccessor(ii)];
+            int id = branch_id(terminator, ii);
+            if (state[w] == 1) {
+                dag.push_back({v, 0, PathEdgeKind::BackExit, terminator, ii, 0, id});
+                dag.push_back({1, w, PathEdgeKind::BackEntry, terminator, ii, 0, 0});
+                continue;
+            }
+            dag.push_back({v, w, PathEdgeKind::Real, terminator, ii, 0, id});
+            if (state[w] == 0) {
+                state[w] = 1;
+                stack.push_back({w, 0});
+            }
+        }
 
-                                        branchInfos.push_back({source_file_name, branch_id_counter, source_line_number, target_line_number});
+        std::vector<std::vector<int>> out(blocks.size());
+        for (unsigned int e = first; e < dag.size(); ++e) {
+            out[dag[e].src].push_back(e);
+        }
 
-                                        IRBuilder<> Builder(func_context);
+        // Number the nodes in reverse topological order of the acyclic graph.
+        std::vector<uint64_t> paths(blocks.size(), 0);
+        std::vector<int> visited(blocks.size(), 0);
+        std::vector<std::pair<int, unsigned int>> order = {{1, 0}};
+        paths[0] = 1;
+        visited[0] = visited[1] = 1;
+        while (!order.empty()) {
+            int v = order.back().first;
+            unsigned int ii = order.back().second++;
+            if (ii < out[v].size()) {
+                int w = dag[out[v][ii]].dst;
+                if (!visited[w]) {
+                    visited[w] = 1;
+                    order.push_back({w, 0});
+                }
+                continue;
+            }
+            order.pop_back();
 
-                                        Builder.SetInsertPoint(&(successor->front()));
+            uint64_t count = 0;
+            for (int e : out[v]) {
+                dag[e].value = count;
+                count += paths[dag[e].dst];
+                if (count > MaxPaths) return false;
+            }
+            paths[v] = count;
+        }
 
-                                        Builder.CreateCall(branch_func_callee, {ConstantInt::get(Type::getInt32Ty(func_context), branch_id_counter)});
+        num_paths = paths[1];
+        return true;
+    }
+
+    // Ball-Larus path profiling: a path register is bumped by the edge values
+    // along the way, and counters[first_counter + register] is incremented
+    // once per path, at function exits and loop back edges. The runtime
+    // turns path numbers back into br_N sequences when the program exits.
+    void instrumentPaths(Module &M, std::vector<BranchEdge> &edges) {
+        if (edges.empty()) return;
+
+        LLVMContext &context = M.getContext();
+        Type *counter_type = Type::getInt64Ty(context);
+        Type *int_type = Type::getInt32Ty(context);
+
+        std::map<std::pair<Instruction*, unsigned int>, int> branch_ids;
+        std::set<Function*> branchy;
+        for (auto &edge : edges) {
+            branch_ids[{edge.branch, edge.successor_index}] = edge.branch_id;
+            branchy.insert(edge.branch->getFunction());
+        }
 
-                                        branch_id_counter++;
-                                    }
+        std::vector<PathEdge> dag;
+        std::vector<PathFunction> functions;
+        int num_counters = 0;
+        for (auto &F : M.functions()) {
+            if (!branchy.count(&F)) continue;
 
-                                }
+            PathFunction function = {&F, (int)dag.size(), 0, num_counters, 0};
+            if (!HasSimpleTerminators(F) || !numberPaths(F, branch_ids, dag, function.num_paths)) {
+                errs() << "SkeletonPass: not path profiling " << F.getName() << ", too many paths or unsupported control flow\n";
+                dag.resize(function.first_edge);
+                continue;
+            }
+            function.num_edges = dag.size() - function.first_edge;
+            num_counters += function.num_paths;
+            functions.push_back(function);
+        }
+        if (functions.empty()) return;
+
+        ArrayType *counters_type = ArrayType::get(counter_type, num_counters);
+        GlobalVariable *counters = new GlobalVariable(M, counters_type, false, GlobalValue::InternalLinkage,
+                                                      Constant::getNullValue(counters_type), "__branch_path_counters");
+
+        for (auto &function : functions) {
+            Function &F = *function.function;
+            IRBuilder<> Builder(&*F.getEntryBlock().getFirstInsertionPt());
+            AllocaInst *path = Builder.CreateAlloca(counter_type, nullptr, "path");
+            Builder.CreateStore(ConstantInt::get(counter_type, 0), path);
+
+            auto count_path = [&](IRBuilder<> &Builder, int value) {
+                Value *index = Builder.CreateAdd(Builder.CreateLoad(counter_type, path),
+                                                 ConstantInt::get(counter_type, function.first_counter + value));
+                CreateCounterIncrement(Builder, counters, index);
+            };
+
+            for (int e = function.first_edge; e < function.first_edge + function.num_edges; ++e) {
+                PathEdge &edge = dag[e];
+                if (edge.kind == PathEdgeKind::Real && edge.value != 0) {
+                    IRBuilder<> Builder(EdgeInsertionPoint(edge.terminator, edge.successor_index));
+                    Value *sum = Builder.CreateAdd(Builder.CreateLoad(counter_type, path), ConstantInt::get(counter_type, edge.value));
+                    Builder.CreateStore(sum, path);
+                } else if (edge.kind == PathEdgeKind::Exit) {
+                    // Paths that end in exit() are counted before the call.
+                    Instruction *insert_before = edge.terminator;
+                    if (isa<UnreachableInst>(edge.terminator)) {
+                        for (auto &I : *edge.terminator->getParent()) {
+                            auto *call = dyn_cast<CallInst>(&I);
+                            if (call && call->doesNotReturn()) {
+                                insert_before = call;
+                                break;
                             }
-
                         }
-
                     }
+                    IRBuilder<> Builder(insert_before);
+                    count_path(Builder, edge.value);
+                } else if (edge.kind == PathEdgeKind::BackExit) {
+                    // The matching BackEntry edge is always the next one.
+                    IRBuilder<> Builder(EdgeInsertionPoint(edge.terminator, edge.successor_index));
+                    count_path(Builder, edge.value);
+                    Builder.CreateStore(ConstantInt::get(counter_type, dag[e + 1].value), path);
+                }
+            }
+        }
+
+        // Describe the numbering for the runtime, see struct branch_path_table in logger.c.
+        std::vector<int> edge_fields;
+        for (auto &edge : dag) {
+            edge_fields.insert(edge_fields.end(), {edge.src, edge.dst, edge.value, edge.branch_id});
+        }
+
+        Type *string_type = Type::getInt8PtrTy(context);
+        StructType *function_type = StructType::get(context, {string_type, int_type, int_type, int_type, int_type});
+        std::vector<Constant*> function_values;
+        for (auto &function : functions) {
+            Constant *name = ConstantDataArray::getString(context, function.function->getName());
+            GlobalVariable *name_string = new GlobalVariable(M, name->getType(), true, GlobalValue::PrivateLinkage, name, "__branch_path_name");
+            function_values.push_back(ConstantStruct::get(function_type, {
+                ConstantExpr::getPointerCast(name_string, string_type),
+                ConstantInt::get(int_type, function.first_edge),
+                ConstantInt::get(int_type, function.num_edges),
+                ConstantInt::get(int_type, function.first_counter),
+                ConstantInt::get(int_type, function.num_paths),
+            }));
+        }
+        ArrayType *functions_type = ArrayType::get(function_type, function_values.size());
+        GlobalVariable *function_table = new GlobalVariable(M, functions_type, true, GlobalValue::InternalLinkage,
+                                                            ConstantArray::get(functions_type, function_values), "__branch_path_functions");
+
+        StructType *table_type = StructType::get(context, {int_type, function_type->getPointerTo(), Type::getInt32PtrTy(context)});
+        Constant *table = ConstantStruct::get(table_type, {
+            ConstantInt::get(int_type, functions.size()),
+            TableStart(function_table),
+            TableStart(CreateInt32Table(M, "__branch_path_edges", edge_fields)),
+        });
+        GlobalVariable *path_table = new GlobalVariable(M, table_type, true, GlobalValue::InternalLinkage, table, "__branch_path_table");
+
+        Constant *args[] = {TableStart(counters), path_table};
+        CreateCounterHook(M, "__branch_paths_open", "BranchPathsOpen", args, false);
+        CreateCounterHook(M, "__branch_paths_dump", "BranchPathsDump", args, true);
+    }
+
+    // SeminalPass marks input dependent branches with !seminal metadata and
+    // the module with !seminal.analyzed. Without that there is nothing to
+    // select on, so everything is instrumented.
+    bool isSelected(Module &M, BranchInst *branch) {
+        if (Select == BranchSelection::All || !M.getNamedMetadata("seminal.analyzed"))
+            return true;
+        bool seminal = branch->getMetadata("seminal") != nullptr;
+        return Select == BranchSelection::Seminal ? seminal : !seminal;
+    }
+
+    PreservedAnalyses run(Module &M, ModuleAnalysisManager &AM) {
+
+        if (Select != BranchSelection::All && !M.getNamedMetadata("seminal.analyzed")) {
+            errs() << "SkeletonPass: -skeleton-select needs SeminalPass to run first, instrumenting every branch\n";
+        }
+
+        const std::vector<BranchInfo> &branchInfos = AM.getResult<BranchInfoAnalysis>(M);
+        std::vector<BranchEdge> edges;
+        std::vector<bool> instrumented;
+        for (const auto &branch : branchInfos) {
+            bool selected = isSelected(M, branch.branch);
+            instrumented.push_back(selected);
+            if (selected) edges.push_back({branch.branch, branch.successor_index, branch.branch_id});
+        }
+
+        for (auto &F : M.functions()) {
+
+            for(auto &B:F) {
+                for(auto & I:B) {
 
                     auto *pointer_instruction = dyn_cast<CallInst>(&I);
                     
-                    if( pointer_instruction){
+                    if( pointer_instruction && Mode == InstrumentMode::Trace){
                         
                         if(!pointer_instruction->getCalledFunction()){
                             
@@ -121,7 +750,7 @@ struct SkeletonPass : public PassInfoMixin<SkeletonPass> {
                             //     errs() << "*funcptr_" << called_value << "\n";
                             // }
 
-                            Builder.CreateCall(pointer_func_callee, called_value);
+                            Builder.CreateCall(CreatePointerFunction(F), called_value);
                         }
                         
                     }
@@ -130,28 +759,52 @@ struct SkeletonPass : public PassInfoMixin<SkeletonPass> {
             
         }
 
-        for (const auto &branch : branchInfos) {
-            file << "br_" << branch.branch_id << ": " << branch.filepath << ", " 
-                << branch.src_lno << ", " << branch.dest_lno << "\n";
+        if (Mode == InstrumentMode::Counters) {
+            instrumentCounters(M, edges, AM);
+        } else if (Mode == InstrumentMode::Paths) {
+            instrumentPaths(M, edges);
+        } else {
+            instrumentTrace(M, edges);
+        }
+
+        EmitBranchInfoSection(M, branchInfos, instrumented);
+
+        if (!BranchInfoFile.empty()) {
+            std::ofstream file(BranchInfoFile, std::ios::out | std::ios::trunc);
+            for (unsigned int i = 0; i < branchInfos.size(); ++i) {
+                const BranchInfo &branch = branchInfos[i];
+                file << "br_" << branch.branch_id << ": " << branch.filepath << ", " 
+                    << branch.src_lno << ", " << branch.dest_lno;
+                if (!instrumented[i]) file << ", uninstrumented";
+                file << "\n";
+            }
+            file.close();
         }
-        file.close();
-        return PreservedAnalyses::all();
+
+        // The branch instructions and their numbering are unchanged, only the
+        // edges around them moved.
+        PreservedAnalyses PA = PreservedAnalyses::none();
+        PA.preserve<BranchInfoAnalysis>();
+        return PA;
     };
 };
 
 }
 
+void registerSkeletonPass(PassBuilder &PB) {
+    registerBranchInfoAnalysis(PB);
+    PB.registerPipelineStartEPCallback(
+        [](ModulePassManager &MPM, OptimizationLevel Level) {
+            MPM.addPass(SkeletonPass());
+        });
+}
+
 extern "C" LLVM_ATTRIBUTE_WEAK ::llvm::PassPluginLibraryInfo
 llvmGetPassPluginInfo() {
     return {
         .APIVersion = LLVM_PLUGIN_API_VERSION,
         .PluginName = "Skeleton pass",
         .PluginVersion = "v0.1",
-        .RegisterPassBuilderCallbacks = [](PassBuilder &PB) {
-            PB.registerPipelineStartEPCallback(
-                [](ModulePassManager &MPM, OptimizationLevel Level) {
-                    MPM.addPass(SkeletonPass());
-                });
-        }
+        .RegisterPassBuilderCallbacks = registerSkeletonPass
     };
-}
\ No newline at end of file
+}
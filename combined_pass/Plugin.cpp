@@ -0,0 +1,22 @@
+#include "BranchInfo.h"
+
+#include "llvm/Passes/PassPlugin.h"
+
+using namespace llvm;
+
+// Runs SeminalPass and then SkeletonPass in one pipeline. The seminal results
+// are then available to -skeleton-select, and the passes share the branch
+// numbering through BranchInfoAnalysis. This definition overrides the weak
+// ones in the single pass sources.
+extern "C" ::llvm::PassPluginLibraryInfo
+llvmGetPassPluginInfo() {
+    return {
+        .APIVersion = LLVM_PLUGIN_API_VERSION,
+        .PluginName = "Branch passes",
+        .PluginVersion = "v0.1",
+        .RegisterPassBuilderCallbacks = [](PassBuilder &PB) {
+            registerSeminalPass(PB);
+            registerSkeletonPass(PB);
+        }
+    };
+}
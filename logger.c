@@ -1,7 +1,209 @@
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "trace_format.h"
+
+// Binary trace mode: when BRANCH_TRACE_FILE names a file, LogBranch and
+// LogPointer append fixed-width records to a per-thread buffer that is written
+// to that file in large blocks. Without it we keep printing br_N to stdout.
+
+#define TRACE_BUFFER_RECORDS 4096
+
+struct trace_buffer {
+    struct trace_buffer *next;
+    uint32_t thread_id;
+    uint32_t count;
+    int busy;                   // the owner is appending to records
+    struct branch_trace_record records[TRACE_BUFFER_RECORDS];
+};
+
+static pthread_once_t trace_once = PTHREAD_ONCE_INIT;
+static pthread_key_t trace_key;
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static int trace_fd = -1;
+static uint32_t trace_next_thread_id = 0;
+// While nonzero (from exit on, and around fork) records skip the buffers and
+// are written to the file under trace_lock.
+static int trace_direct = 0;
+static struct trace_buffer *trace_buffers = NULL;
+static __thread struct trace_buffer *trace_local = NULL;
+// Set once the thread's buffer is gone, for records logged by TSD destructors
+// that run after ours.
+static __thread int trace_thread_gone = 0;
+static __thread uint32_t trace_thread_id;
+
+static void trace_write_all(const void *data, size_t size) {
+    const char *p = data;
+    while (size > 0) {
+        ssize_t n = write(trace_fd, p, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        p += n;
+        size -= (size_t)n;
+    }
+}
+
+static void trace_flush(struct trace_buffer *buf) {
+    if (buf->count == 0) return;
+    trace_write_all(buf->records, buf->count * sizeof(struct branch_trace_record));
+    buf->count = 0;
+}
+
+static void trace_write_record(const struct branch_trace_record *rec) {
+    pthread_mutex_lock(&trace_lock);
+    trace_write_all(rec, sizeof(*rec));
+    pthread_mutex_unlock(&trace_lock);
+}
+
+// Switches appends to direct writes, waits for the ones already inside a
+// buffer to finish, and writes out every buffer. Other threads may still be
+// logging. Returns with trace_lock held.
+static void trace_drain(void) {
+    __atomic_add_fetch(&trace_direct, 1, __ATOMIC_SEQ_CST);
+    for (;;) {
+        pthread_mutex_lock(&trace_lock);
+        int busy = 0;
+        for (struct trace_buffer *buf = trace_buffers; buf; buf = buf->next) {
+            busy |= __atomic_load_n(&buf->busy, __ATOMIC_SEQ_CST);
+        }
+        if (!busy) break;
+        // A busy owner may need the lock to flush a full buffer.
+        pthread_mutex_unlock(&trace_lock);
+        sched_yield();
+    }
+    for (struct trace_buffer *buf = trace_buffers; buf; buf = buf->next) {
+        trace_flush(buf);
+    }
+}
+
+// The exit flush. atexit handlers registered before it and destructors still
+// run after it, so from here on every record is written as soon as it is
+// logged.
+static void trace_exit(void) {
+    trace_drain();
+    pthread_mutex_unlock(&trace_lock);
+}
+
+// Runs when a thread exits: write out what is left and forget the buffer.
+static void trace_thread_exit(void *arg) {
+    struct trace_buffer *buf = arg;
+    pthread_mutex_lock(&trace_lock);
+    trace_flush(buf);
+    for (struct trace_buffer **p = &trace_buffers; *p; p = &(*p)->next) {
+        if (*p == buf) {
+            *p = buf->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&trace_lock);
+    trace_thread_id = buf->thread_id;
+    trace_thread_gone = 1;
+    trace_local = NULL;
+    free(buf);
+}
+
+// A forked child would otherwise inherit and re-emit the parent's
+// unflushed records. The lock is held across fork so the child does not
+// inherit it taken by a thread that no longer exists there.
+static void trace_before_fork(void) {
+    trace_drain();
+}
+
+static void trace_after_fork(void) {
+    pthread_mutex_unlock(&trace_lock);
+    __atomic_sub_fetch(&trace_direct, 1, __ATOMIC_SEQ_CST);
+}
+
+static void trace_init(void) {
+    const char *path = getenv("BRANCH_TRACE_FILE");
+    if (!path || !*path) return;
+
+    trace_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (trace_fd < 0) {
+        fprintf(stderr, "logger: could not open %s, falling back to stdout\n", path);
+        return;
+    }
+
+    struct branch_trace_header header;
+    memcpy(header.magic, BRANCH_TRACE_MAGIC, sizeof(header.magic));
+    header.version = BRANCH_TRACE_VERSION;
+    header.record_size = sizeof(struct branch_trace_record);
+    trace_write_all(&header, sizeof(header));
+
+    pthread_key_create(&trace_key, trace_thread_exit);
+    pthread_atfork(trace_before_fork, trace_after_fork, trace_after_fork);
+    atexit(trace_exit);
+}
+
+static struct trace_buffer *trace_buffer_get(void) {
+    if (trace_local) return trace_local;
+
+    struct trace_buffer *buf = malloc(sizeof(struct trace_buffer));
+    if (!buf) return NULL;
+    buf->count = 0;
+    buf->busy = 0;
+
+    pthread_mutex_lock(&trace_lock);
+    buf->thread_id = trace_next_thread_id++;
+    buf->next = trace_buffers;
+    trace_buffers = buf;
+    pthread_mutex_unlock(&trace_lock);
+
+    pthread_setspecific(trace_key, buf);
+    trace_local = buf;
+    return buf;
+}
+
+// Returns 1 if the event went to the binary trace, 0 if the caller should
+// fall back to text output.
+static int trace_append(uint32_t branch_id, uint64_t pointer) {
+    pthread_once(&trace_once, trace_init);
+    if (trace_fd < 0) return 0;
+
+    struct branch_trace_record rec = {branch_id, trace_thread_id, pointer};
+    if (trace_thread_gone) {
+        trace_write_record(&rec);
+        return 1;
+    }
+
+    struct trace_buffer *buf = trace_buffer_get();
+    if (!buf) return 0;
+    rec.thread_id = buf->thread_id;
+
+    // busy is set before trace_direct is checked, and trace_drain sets
+    // trace_direct before it checks busy, so either this append sees
+    // trace_direct or the drain waits for it.
+    __atomic_store_n(&buf->busy, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&trace_direct, __ATOMIC_SEQ_CST)) {
+        __atomic_store_n(&buf->busy, 0, __ATOMIC_RELEASE);
+        trace_write_record(&rec);
+        return 1;
+    }
+
+    buf->records[buf->count++] = rec;
+    if (buf->count == TRACE_BUFFER_RECORDS) {
+        pthread_mutex_lock(&trace_lock);
+        trace_flush(buf);
+        pthread_mutex_unlock(&trace_lock);
+    }
+    __atomic_store_n(&buf->busy, 0, __ATOMIC_RELEASE);
+    return 1;
+}
 
 void LogBranch(int branchId, const char* filepath, int srcLine, int successor) {
+    (void)filepath;
+    (void)srcLine;
+    (void)successor;
+    if (trace_append((uint32_t)branchId, 0)) return;
     printf("br_%d\n",branchId);
     fflush(stdout);
 }
@@ -9,8 +211,234 @@ void LogBranch(int branchId, const char* filepath, int srcLine, int successor) {
 
 void LogPointer(void (*funcPtr)()) {
     uintptr_t funcPtrValue = (uintptr_t)funcPtr;
+    if (trace_append(0, (uint64_t)funcPtrValue)) return;
     printf("*funcptr_%p\n", (void*)funcPtrValue);
 }
 
 
+// Counters mode: SkeletonPass keeps one hit counter per branch id in each
+// module, calls BranchCountersOpen from a constructor and BranchCountersDump
+// from a destructor. All modules of a program append to the same file,
+// BRANCH_COUNTS_FILE or branch_counts.txt by default.
+
+static pthread_once_t counters_once = PTHREAD_ONCE_INIT;
+
+static const char *counters_path(void) {
+    const char *path = getenv("BRANCH_COUNTS_FILE");
+    return (path && *path) ? path : "branch_counts.txt";
+}
+
+static void counters_truncate(void) {
+    FILE *out = fopen(counters_path(), "w");
+    if (out) fclose(out);
+}
+
+// The tables are only read at exit, by BranchCountersDump.
+void BranchCountersOpen(uint64_t *counters, const int32_t *ids, int32_t count) {
+    (void)counters;
+    (void)ids;
+    (void)count;
+    pthread_once(&counters_once, counters_truncate);
+}
+
+void BranchCountersDump(uint64_t *counters, const int32_t *ids, int32_t count) {
+    FILE *out = fopen(counters_path(), "a");
+    if (!out) {
+        fprintf(stderr, "logger: could not open %s\n", counters_path());
+        return;
+    }
+    for (int32_t i = 0; i < count; i++) {
+        fprintf(out, "br_%d: %llu\n", ids[i], (unsigned long long)counters[i]);
+    }
+    fclose(out);
+}
+
+// Spanning tree placement: only edges off a spanning tree of each function's
+// CFG have a counter (slot >= 0). The others are solved here from flow
+// conservation, which holds at every node because the pass adds a virtual
+// node 0 linking the exits back to the entry.
+
+struct branch_counter_edge {
+    int32_t src;
+    int32_t dst;
+    int32_t slot;
+};
+
+struct branch_counter_function {
+    int32_t num_nodes;
+    int32_t first_edge;
+    int32_t num_edges;
+};
+
+struct branch_counter_graph {
+    const int32_t *ids;
+    const int32_t *id_edges;    // graph edge whose count is reported for ids[i]
+    int32_t num_ids;
+    int32_t num_functions;
+    const struct branch_counter_function *functions;
+    const struct branch_counter_edge *edges;
+};
+
+// Fills counts[first_edge .. first_edge + num_edges) for one function.
+static void counters_solve(const struct branch_counter_function *fn, const struct branch_counter_edge *edges,
+                           const uint64_t *counters, int64_t *counts) {
+    const struct branch_counter_edge *fe = edges + fn->first_edge;
+    int64_t *fc = counts + fn->first_edge;
+    int32_t n = fn->num_edges;
+
+    char *known = calloc(n, 1);
+    int32_t *unknown = calloc(fn->num_nodes, sizeof(int32_t));
+    int64_t *balance = calloc(fn->num_nodes, sizeof(int64_t));   // in - out over known edges
+    int32_t *queue = malloc(sizeof(int32_t) * (fn->num_nodes + 1));
+    if (!known || !unknown || !balance || !queue) goto done;
+
+    for (int32_t e = 0; e < n; e++) {
+        if (fe[e].slot >= 0) {
+            known[e] = 1;
+            fc[e] = (int64_t)counters[fe[e].slot];
+            balance[fe[e].dst] += fc[e];
+            balance[fe[e].src] -= fc[e];
+        } else {
+            unknown[fe[e].src]++;
+            unknown[fe[e].dst]++;
+        }
+    }
+
+    // Repeatedly pick a node with a single unknown edge and settle it.
+    int32_t head = 0, tail = 0;
+    for (int32_t v = 0; v < fn->num_nodes; v++) {
+        if (unknown[v] == 1) queue[tail++] = v;
+    }
+    while (head < tail) {
+        int32_t v = queue[head++];
+        if (unknown[v] != 1) continue;
+        for (int32_t e = 0; e < n; e++) {
+            if (known[e] || (fe[e].src != v && fe[e].dst != v)) continue;
+            fc[e] = fe[e].dst == v ? -balance[v] : balance[v];
+            known[e] = 1;
+            balance[fe[e].dst] += fc[e];
+            balance[fe[e].src] -= fc[e];
+            unknown[fe[e].src]--;
+            unknown[fe[e].dst]--;
+            int32_t other = fe[e].src == v ? fe[e].dst : fe[e].src;
+            if (unknown[other] == 1 && tail <= fn->num_nodes) queue[tail++] = other;
+            break;
+        }
+    }
+
+done:
+    free(known);
+    free(unknown);
+    free(balance);
+    free(queue);
+}
+
+void BranchCountersDumpGraph(uint64_t *counters, const struct branch_counter_graph *graph) {
+    int32_t num_edges = 0;
+    for (int32_t f = 0; f < graph->num_functions; f++) {
+        num_edges += graph->functions[f].num_edges;
+    }
+
+    int64_t *counts = calloc(num_edges ? num_edges : 1, sizeof(int64_t));
+    if (!counts) return;
+    for (int32_t f = 0; f < graph->num_functions; f++) {
+        counters_solve(&graph->functions[f], graph->edges, counters, counts);
+    }
+
+    FILE *out = fopen(counters_path(), "a");
+    if (!out) {
+        fprintf(stderr, "logger: could not open %s\n", counters_path());
+        free(counts);
+        return;
+    }
+    for (int32_t i = 0; i < graph->num_ids; i++) {
+        fprintf(out, "br_%d: %lld\n", graph->ids[i], (long long)counts[graph->id_edges[i]]);
+    }
+    fclose(out);
+    free(counts);
+}
+
+
+// Paths mode: SkeletonPass numbers the acyclic paths of each function
+// (Ball-Larus) and counts how often each one ran. At exit every path number
+// is walked back through the numbered graph to list the br_N edges it took.
+// Node 0 is the virtual exit and node 1 the entry block; an edge id of 0 means
+// the edge is not a br_N edge.
 
+struct branch_path_edge {
+    int32_t src;
+    int32_t dst;
+    int32_t value;
+    int32_t branch_id;
+};
+
+struct branch_path_function {
+    const char *name;
+    int32_t first_edge;
+    int32_t num_edges;
+    int32_t first_counter;
+    int32_t num_paths;
+};
+
+struct branch_path_table {
+    int32_t num_functions;
+    const struct branch_path_function *functions;
+    const struct branch_path_edge *edges;
+};
+
+static pthread_once_t paths_once = PTHREAD_ONCE_INIT;
+
+static const char *paths_path(void) {
+    const char *path = getenv("BRANCH_PATHS_FILE");
+    return (path && *path) ? path : "branch_paths.txt";
+}
+
+static void paths_truncate(void) {
+    FILE *out = fopen(paths_path(), "w");
+    if (out) fclose(out);
+}
+
+// Like BranchCountersOpen, the tables are only read at exit.
+void BranchPathsOpen(uint64_t *counters, const struct branch_path_table *table) {
+    (void)counters;
+    (void)table;
+    pthread_once(&paths_once, paths_truncate);
+}
+
+static void paths_print(FILE *out, const struct branch_path_function *fn, const struct branch_path_edge *edges,
+                        int32_t path) {
+    const struct branch_path_edge *fe = edges + fn->first_edge;
+    int32_t node = 1, remaining = path;
+
+    while (node != 0) {
+        int32_t best = -1;
+        for (int32_t e = 0; e < fn->num_edges; e++) {
+            if (fe[e].src == node && fe[e].value <= remaining && (best < 0 || fe[e].value > fe[best].value)) {
+                best = e;
+            }
+        }
+        if (best < 0) break;
+        if (fe[best].branch_id) fprintf(out, " br_%d", fe[best].branch_id);
+        remaining -= fe[best].value;
+        node = fe[best].dst;
+    }
+}
+
+void BranchPathsDump(uint64_t *counters, const struct branch_path_table *table) {
+    FILE *out = fopen(paths_path(), "a");
+    if (!out) {
+        fprintf(stderr, "logger: could not open %s\n", paths_path());
+        return;
+    }
+    for (int32_t f = 0; f < table->num_functions; f++) {
+        const struct branch_path_function *fn = &table->functions[f];
+        for (int32_t p = 0; p < fn->num_paths; p++) {
+            uint64_t count = counters[fn->first_counter + p];
+            if (!count) continue;
+            fprintf(out, "%s path_%d: %llu:", fn->name, p, (unsigned long long)count);
+            paths_print(out, fn, table->edges, p);
+            fprintf(out, "\n");
+        }
+    }
+    fclose(out);
+}
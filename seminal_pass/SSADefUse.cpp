@@ -0,0 +1,371 @@
+#include "SSADefUse.h"
+
+#include "llvm/Analysis/MemorySSA.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/DebugInfo.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Operator.h"
+
+using namespace llvm;
+
+namespace {
+    enum class InputCall { None, Scanf, Fopen, Fread, Getc };
+
+    InputCall inputCallKind(const Function *callee) {
+        if (!callee) return InputCall::None;
+        StringRef name = callee->getName();
+        if (name == "scanf" || name == "__isoc99_scanf") return InputCall::Scanf;
+        if (name == "fopen" || name == "fopen64") return InputCall::Fopen;
+        if (name == "fread") return InputCall::Fread;
+        if (name == "getc" || name == "fgetc" || name == "_IO_getc") return InputCall::Getc;
+        return InputCall::None;
+    }
+
+    Function *calledFunction(const CallBase *call) {
+        return dyn_cast<Function>(call->getCalledOperand()->stripPointerCasts());
+    }
+
+    // The parameter a pointer comes from. Unoptimized code spills every
+    // parameter to a stack slot first, so besides the argument itself this
+    // also accepts a load from a slot whose only stores write the argument.
+    const Argument *pointerArgument(const Value *object) {
+        if (auto *A = dyn_cast<Argument>(object)) return A;
+
+        auto *L = dyn_cast<LoadInst>(object);
+        if (!L) return nullptr;
+        auto *slot = dyn_cast<AllocaInst>(L->getPointerOperand()->stripPointerCasts());
+        if (!slot) return nullptr;
+
+        const Argument *arg = nullptr;
+        for (const User *U : slot->users()) {
+            auto *S = dyn_cast<StoreInst>(U);
+            if (!S || S->getPointerOperand() != slot) continue;
+            auto *stored = dyn_cast<Argument>(S->getValueOperand());
+            if (!stored || (arg && arg != stored)) return nullptr;
+            arg = stored;
+        }
+        return arg;
+    }
+}
+
+SSADefUse::SSADefUse(Module &M, FunctionAnalysisManager &FAM, unsigned max_steps)
+    : M(M), FAM(FAM), max_steps(max_steps), steps(0) {
+    for (Function &F : M) {
+        for (Instruction &I : instructions(F)) {
+            if (auto *call = dyn_cast<CallBase>(&I)) {
+                if (Function *callee = calledFunction(call)) call_sites[callee].push_back(call);
+            } else if (auto *S = dyn_cast<StoreInst>(&I)) {
+                const Value *object = getUnderlyingObject(S->getPointerOperand());
+                if (isa<GlobalVariable>(object)) global_stores[object].push_back(S);
+            }
+        }
+    }
+}
+
+std::vector<SeminalInput> SSADefUse::inputsOf(ArrayRef<BranchInst*> branches, bool &exhausted) {
+    value_worklist.clear();
+    memory_worklist.clear();
+    seen_values.clear();
+    seen_memory.clear();
+    inputs.clear();
+    steps = 0;
+    exhausted = false;
+
+    for (BranchInst *br : branches) {
+        if (br->isConditional()) traceValue(br->getCondition());
+    }
+
+    while (!value_worklist.empty() || !memory_worklist.empty()) {
+        if (++steps > max_steps) {
+            exhausted = true;
+            break;
+        }
+        if (!value_worklist.empty()) {
+            Value *V = value_worklist.back();
+            value_worklist.pop_back();
+            visitValue(V);
+        } else {
+            MemoryItem item = memory_worklist.back();
+            memory_worklist.pop_back();
+            visitMemory(item);
+        }
+    }
+    return std::move(inputs);
+}
+
+void SSADefUse::traceValue(Value *V) {
+    if (seen_values.insert(V).second) value_worklist.push_back(V);
+}
+
+void SSADefUse::traceMemory(const MemoryItem &item) {
+    const Value *object = getUnderlyingObject(item.location.Ptr);
+    if (seen_memory.insert({item.access, object}).second) memory_worklist.push_back(item);
+}
+
+void SSADefUse::visitValue(Value *V) {
+    // A parameter is whatever the callers pass.
+    if (auto *A = dyn_cast<Argument>(V)) {
+        for (CallBase *call : call_sites.lookup(A->getParent())) {
+            if (A->getArgNo() < call->arg_size()) traceValue(call->getArgOperand(A->getArgNo()));
+        }
+        return;
+    }
+
+    // Constants and globals themselves carry no input; loads from globals do.
+    auto *I = dyn_cast<Instruction>(V);
+    if (!I || isa<AllocaInst>(I)) return;
+
+    if (auto *L = dyn_cast<LoadInst>(I)) {
+        traceValue(L->getPointerOperand());
+        Function &F = *L->getFunction();
+        MemorySSA &MSSA = memorySSA(F);
+        traceMemory({MSSA.getWalker()->getClobberingMemoryAccess(L), MemoryLocation::get(L), &F});
+        return;
+    }
+
+    if (auto *call = dyn_cast<CallBase>(I)) {
+        traceCall(call);
+        return;
+    }
+
+    if (auto *phi = dyn_cast<PHINode>(I)) {
+        SmallVector<BasicBlock*, 4> incoming(phi->blocks());
+        traceMergeConditions(phi->getParent(), incoming);
+    }
+    for (Value *op : I->operands()) {
+        if (!isa<BasicBlock>(op)) traceValue(op);
+    }
+}
+
+void SSADefUse::visitMemory(const MemoryItem &item) {
+    const Value *object = getUnderlyingObject(item.location.Ptr);
+
+    // Globals can be written from anywhere, so take every store to them.
+    if (isa<GlobalVariable>(object)) {
+        for (StoreInst *S : global_stores.lookup(object)) traceValue(S->getValueOperand());
+        return;
+    }
+
+    MemorySSA &MSSA = memorySSA(*item.F);
+    MemorySSAWalker *walker = MSSA.getWalker();
+
+    // Nothing in the function wrote it: memory reached through a parameter
+    // holds what the callers had there at the call.
+    if (MSSA.isLiveOnEntryDef(item.access)) {
+        const Argument *A = pointerArgument(object);
+        if (!A) return;
+        for (CallBase *call : call_sites.lookup(A->getParent())) {
+            if (A->getArgNo() >= call->arg_size()) continue;
+            Function &caller = *call->getFunction();
+            MemorySSA &caller_mssa = memorySSA(caller);
+            MemoryUseOrDef *at_call = caller_mssa.getMemoryAccess(call);
+            if (!at_call) continue;
+            MemoryLocation location = MemoryLocation::getBeforeOrAfter(call->getArgOperand(A->getArgNo()));
+            traceMemory({caller_mssa.getWalker()->getClobberingMemoryAccess(at_call->getDefiningAccess(), location),
+                         location, &caller});
+        }
+        return;
+    }
+
+    if (auto *phi = dyn_cast<MemoryPhi>(item.access)) {
+        SmallVector<BasicBlock*, 4> incoming;
+        for (unsigned i = 0; i < phi->getNumIncomingValues(); ++i) {
+            incoming.push_back(phi->getIncomingBlock(i));
+            traceMemory({walker->getClobberingMemoryAccess(phi->getIncomingValue(i), item.location),
+                         item.location, item.F});
+        }
+        traceMergeConditions(phi->getBlock(), incoming);
+        return;
+    }
+
+    Instruction *I = cast<MemoryUseOrDef>(item.access)->getMemoryInst();
+    if (auto *S = dyn_cast<StoreInst>(I)) {
+        traceValue(S->getValueOperand());
+        return;
+    }
+
+    if (auto *call = dyn_cast<CallBase>(I)) {
+        if (traceInputCall(call, item.location.Ptr)) return;
+
+        // A call that gets the location's address may write it: a defined
+        // callee through the matching parameter, an unknown one from any of
+        // its arguments.
+        Function *callee = calledFunction(call);
+        bool passed = false;
+        for (unsigned i = 0; i < call->arg_size(); ++i) {
+            if (getUnderlyingObject(call->getArgOperand(i)) != object) continue;
+            passed = true;
+            if (callee && !callee->isDeclaration()) traceCalleeStores(callee, i);
+        }
+        if (passed && (!callee || callee->isDeclaration())) traceCallArguments(call);
+    }
+
+    // The write may not cover the location, or not on every path: keep going
+    // above it.
+    auto *def = cast<MemoryUseOrDef>(item.access);
+    traceMemory({walker->getClobberingMemoryAccess(def->getDefiningAccess(), item.location), item.location, item.F});
+}
+
+void SSADefUse::traceCall(CallBase *call) {
+    if (traceInputCall(call, nullptr)) return;
+
+    Function *callee = calledFunction(call);
+    if (callee && !callee->isDeclaration()) {
+        for (BasicBlock &BB : *callee) {
+            if (auto *ret = dyn_cast<ReturnInst>(BB.getTerminator())) {
+                if (Value *value = ret->getReturnValue()) traceValue(value);
+            }
+        }
+        return;
+    }
+    // Unknown code: the result may depend on any argument.
+    traceCallArguments(call);
+}
+
+// Records `call` if it reads input. With `location` null the call's result is
+// being traced, otherwise the memory at `location` that the call wrote.
+bool SSADefUse::traceInputCall(CallBase *call, const Value *location) {
+    switch (inputCallKind(calledFunction(call))) {
+    case InputCall::None:
+        return false;
+
+    case InputCall::Scanf:
+        if (!location) {
+            addInput({SeminalInput::ScanfResult, resultName(call), "", ""});
+            return true;
+        }
+        for (unsigned i = 1; i < call->arg_size(); ++i) {
+            if (getUnderlyingObject(call->getArgOperand(i)) == getUnderlyingObject(location)) {
+                std::string name = variableName(call->getArgOperand(i));
+                addInput({SeminalInput::ScanfArgument, name, name, ""});
+                return true;
+            }
+        }
+        return false;
+
+    case InputCall::Fopen:
+        if (location) return false;
+        addInput({SeminalInput::Fopen, resultName(call), describe(call->getArgOperand(0)),
+                  describe(call->getArgOperand(1))});
+        return true;
+
+    case InputCall::Fread:
+        if (call->arg_size() < 4) return false;
+        if (location && getUnderlyingObject(call->getArgOperand(0)) != getUnderlyingObject(location))
+            return false;
+        addInput({SeminalInput::Fread, location ? variableName(location) : resultName(call),
+                  describe(call->getArgOperand(0)), ""});
+        traceValue(call->getArgOperand(3));
+        return true;
+
+    case InputCall::Getc:
+        if (location || call->arg_size() < 1) return false;
+        addInput({SeminalInput::Getc, resultName(call), describe(call->getArgOperand(0)), ""});
+        traceValue(call->getArgOperand(0));
+        return true;
+    }
+    return false;
+}
+
+void SSADefUse::traceCallArguments(CallBase *call) {
+    for (Value *arg : call->args()) traceValue(arg);
+}
+
+// Values `callee` stores through its parameter `arg_no`.
+void SSADefUse::traceCalleeStores(Function *callee, unsigned arg_no) {
+    if (arg_no >= callee->arg_size()) return;
+    Argument *A = callee->getArg(arg_no);
+    for (Instruction &I : instructions(*callee)) {
+        auto *S = dyn_cast<StoreInst>(&I);
+        if (S && pointerArgument(getUnderlyingObject(S->getPointerOperand())) == A)
+            traceValue(S->getValueOperand());
+    }
+}
+
+// Which of `incoming` reaches `block` is decided by the branches between
+// their common dominator and each incoming block.
+void SSADefUse::traceMergeConditions(BasicBlock *block, ArrayRef<BasicBlock*> incoming) {
+    if (incoming.empty()) return;
+    DominatorTree &DT = FAM.getResult<DominatorTreeAnalysis>(*block->getParent());
+
+    BasicBlock *common = incoming.front();
+    for (BasicBlock *BB : incoming.drop_front()) {
+        if (!common) break;
+        common = DT.findNearestCommonDominator(common, BB);
+    }
+
+    for (BasicBlock *BB : incoming) {
+        for (DomTreeNode *node = DT.getNode(BB); node; node = node->getIDom()) {
+            Instruction *term = node->getBlock()->getTerminator();
+            if (auto *br = dyn_cast<BranchInst>(term)) {
+                if (br->isConditional()) traceValue(br->getCondition());
+            } else if (auto *sw = dyn_cast<SwitchInst>(term)) {
+                traceValue(sw->getCondition());
+            }
+            if (node->getBlock() == common) break;
+        }
+    }
+}
+
+void SSADefUse::addInput(SeminalInput input) {
+    if (std::find(inputs.begin(), inputs.end(), input) == inputs.end()) inputs.push_back(std::move(input));
+}
+
+MemorySSA &SSADefUse::memorySSA(Function &F) {
+    return FAM.getResult<MemorySSAAnalysis>(F).getMSSA();
+}
+
+// Source name of the variable V points into or holds, or "unknown".
+std::string SSADefUse::variableName(const Value *V) {
+    const Value *object = getUnderlyingObject(V);
+
+    if (auto *GV = dyn_cast<GlobalVariable>(object)) {
+        SmallVector<DIGlobalVariableExpression*, 1> exprs;
+        GV->getDebugInfo(exprs);
+        if (!exprs.empty()) return exprs.front()->getVariable()->getName().str();
+        return "unknown";
+    }
+
+    Value *value = const_cast<Value*>(object);
+#if LLVM_VERSION_MAJOR >= 19
+    for (DbgDeclareInst *declare : findDbgDeclares(value))
+        return declare->getVariable()->getName().str();
+#else
+    for (DbgVariableIntrinsic *declare : FindDbgDeclareUses(value))
+        return declare->getVariable()->getName().str();
+#endif
+
+    SmallVector<DbgValueInst*, 1> values;
+    findDbgValues(values, value);
+    if (!values.empty()) return values.front()->getVariable()->getName().str();
+    return "unknown";
+}
+
+// Name of the variable a call's result is stored in, possibly after a
+// conversion to the variable's type.
+std::string SSADefUse::resultName(CallBase *call) {
+    Value *result = call;
+    if (call->hasOneUse() && isa<CastInst>(call->user_back())) result = call->user_back();
+    for (User *U : result->users()) {
+        auto *S = dyn_cast<StoreInst>(U);
+        if (S && S->getValueOperand() == result) return variableName(S->getPointerOperand());
+    }
+    return variableName(result);
+}
+
+// How an argument reads in the source: a number, a string literal, or the
+// variable it is loaded from.
+std::string SSADefUse::describe(Value *V) {
+    if (auto *C = dyn_cast<ConstantInt>(V)) return std::to_string(C->getSExtValue());
+
+    StringRef text;
+    if (getConstantStringInfo(V, text)) return "\"" + text.str() + "\"";
+
+    if (auto *L = dyn_cast<LoadInst>(V)) return variableName(L->getPointerOperand());
+    return variableName(V);
+}
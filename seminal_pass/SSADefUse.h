@@ -0,0 +1,75 @@
+#ifndef SEMINAL_SSA_DEF_USE_H
+#define SEMINAL_SSA_DEF_USE_H
+
+#include "SeminalFinding.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Analysis/MemoryLocation.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/PassManager.h"
+
+#include <vector>
+
+namespace llvm {
+class MemoryAccess;
+class MemorySSA;
+}
+
+// Finds the inputs a branch condition depends on from the IR alone: SSA
+// use-def chains, MemorySSA clobbers for loads, call sites for parameters,
+// callee returns for calls, and the branches that decide which value reaches
+// a merge point. It reports the same kinds of inputs as the source-line
+// analysis in SeminalPass, without reading any source files.
+class SSADefUse {
+public:
+    SSADefUse(llvm::Module &M, llvm::FunctionAnalysisManager &FAM, unsigned max_steps);
+
+    // Inputs the conditions of `branches` depend on, in the order they were
+    // found. `exhausted` is set when the step budget ran out.
+    std::vector<SeminalInput> inputsOf(llvm::ArrayRef<llvm::BranchInst*> branches, bool &exhausted);
+
+private:
+    // Memory at `access` for the location `location` in function F.
+    struct MemoryItem {
+        llvm::MemoryAccess *access;
+        llvm::MemoryLocation location;
+        llvm::Function *F;
+    };
+
+    // trace* queue a value or memory state once, visit* follow it one step.
+    void traceValue(llvm::Value *V);
+    void traceMemory(const MemoryItem &item);
+    void visitValue(llvm::Value *V);
+    void visitMemory(const MemoryItem &item);
+    void traceCall(llvm::CallBase *call);
+    bool traceInputCall(llvm::CallBase *call, const llvm::Value *location);
+    void traceCallArguments(llvm::CallBase *call);
+    void traceCalleeStores(llvm::Function *callee, unsigned arg_no);
+    void traceMergeConditions(llvm::BasicBlock *block, llvm::ArrayRef<llvm::BasicBlock*> incoming);
+    void addInput(SeminalInput input);
+
+    llvm::MemorySSA &memorySSA(llvm::Function &F);
+    std::string variableName(const llvm::Value *V);
+    std::string resultName(llvm::CallBase *call);
+    std::string describe(llvm::Value *V);
+
+    llvm::Module &M;
+    llvm::FunctionAnalysisManager &FAM;
+    unsigned max_steps;
+
+    llvm::DenseMap<const llvm::Function*, std::vector<llvm::CallBase*>> call_sites;
+    llvm::DenseMap<const llvm::Value*, std::vector<llvm::StoreInst*>> global_stores;
+
+    // State of one inputsOf query.
+    std::vector<llvm::Value*> value_worklist;
+    std::vector<MemoryItem> memory_worklist;
+    llvm::SmallPtrSet<const llvm::Value*, 32> seen_values;
+    llvm::DenseSet<std::pair<const llvm::MemoryAccess*, const llvm::Value*>> seen_memory;
+    unsigned steps;
+    std::vector<SeminalInput> inputs;
+};
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef SEMINAL_FINDING_H
+#define SEMINAL_FINDING_H
+
+#include <string>
+#include <vector>
+
+// An input a seminal branch depends on: how it is read, by which variable,
+// and from what (the variable itself for scanf, the path for fopen, the
+// stream or buffer for getc and fread).
+struct SeminalInput {
+    enum Kind { ScanfArgument, ScanfResult, Fopen, Fread, Getc } kind;
+    std::string variable;
+    std::string object;
+    std::string mode;           // fopen only
+
+    bool operator==(const SeminalInput &other) const {
+        return kind == other.kind && variable == other.variable && object == other.object && mode == other.mode;
+    }
+
+    // The def-use line for this input, as written to def-use-out.txt.
+    std::string render() const {
+        switch (kind) {
+        case ScanfArgument:
+            return "#:" + variable + " gets value from user input via scanf";
+        case ScanfResult:
+            return "#: " + variable + " gets value from user input";
+        case Fopen:
+            return "#: " + variable + " gets value from file at path " + object + " opened in mode " + mode;
+        case Fread:
+            return "#: " + variable + " gets value from file buffer named " + object;
+        case Getc:
+            return "#: " + variable + " gets value from each character in variable called " + object;
+        }
+        return "";
+    }
+};
+
+// One reported chain from a branch line to its inputs.
+struct SeminalFinding {
+    std::string branch_id;
+    int line;
+    std::vector<SeminalInput> inputs;
+    std::vector<std::string> path;
+};
+
+#endif
@@ -1,13 +1,50 @@
 #include "sp.hpp"
+#include "BranchInfo.h"
+#include "SourceCache.h"
+#include "SeminalFinding.h"
+#include "SSADefUse.h"
+
+#include "llvm/Analysis/CallGraph.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/Support/ThreadPool.h"
 
 using namespace llvm;
 
 namespace {
-    struct SeminalPass : public PassInfoMixin<SeminalPass> {
-    private:
-        std::map<Value*, std::string> varNames;
-        std::map<Value*, DILocalVariable*> debugVars;
-        string current_scope = "global";
+    cl::opt<unsigned> SeminalMaxDepth("seminal-max-depth",
+        cl::desc("Longest def-use chain SeminalPass follows from a branch variable"),
+        cl::init(10000));
+
+    cl::opt<unsigned> SeminalMaxNodes("seminal-max-nodes",
+        cl::desc("Most variables SeminalPass visits per branch line"),
+        cl::init(1000000));
+
+    cl::opt<bool> SeminalAllPaths("seminal-all-paths",
+        cl::desc("Report every def-use chain that reaches an input, not just the first per variable"),
+        cl::init(false));
+
+    enum class SeminalEngineKind { Source, SSA };
+
+    cl::opt<SeminalEngineKind> SeminalEngine("seminal-engine",
+        cl::desc("How SeminalPass finds the inputs of a branch"),
+        cl::values(clEnumValN(SeminalEngineKind::Source, "source", "def-use chains parsed from the source lines (default)"),
+                   clEnumValN(SeminalEngineKind::SSA, "ssa", "SSA and MemorySSA def-use chains, no source files needed")),
+        cl::init(SeminalEngineKind::Source));
+
+    cl::opt<unsigned> SeminalThreads("seminal-threads",
+        cl::desc("Threads SeminalPass collects facts and answers branch queries on (0 = one per core)"),
+        cl::init(0));
+
+    // Everything SeminalPass knows about one module. Built fresh for every
+    // run and dropped with it, so nothing carries over between modules and
+    // several modules can be analyzed at once.
+    class SeminalAnalysis : SeminalFacts {
+        // Names of the global variables; locals are named in each FactShard.
+        DenseMap<const Value*, symbol> varNames;
+        SourceCache sources;
+
+        struct FactShard;
 
         void analyzeGlobalVariables(Module &M) {
             for (GlobalVariable &GV : M.globals()) {
@@ -16,14 +53,15 @@ namespace {
                     DIGlobalVariable *DGV = DIGVE->getVariable();
                     
                     var_map vm;
-                    vm.name = DGV->getName().str();
-                    vm.scope = "global";
+                    vm.name = symbols.intern(DGV->getName());
+                    vm.scope = sym_global;
+                    vm.file = symbols.intern(DGV->getFilename());
                     vm.defined_at_line = DGV->getLine();
                     vm.gets_value_infos = std::vector<get_list>();
-                    variable_infos.push_back(vm);
+                    add_variable_info(vm);
                     
                     // Track the name for later use
-                    varNames[&GV] = DGV->getName().str();
+                    varNames[&GV] = vm.name;
 
                     // Check initializer
                     if (GV.hasInitializer()) {
@@ -33,85 +71,85 @@ namespace {
             }
         }
 
-        void printFunctionHeader(Function& F) {
+        void printFunctionHeader(FactShard &shard, Function& F) {
             DISubprogram* SP = F.getSubprogram();
             unsigned line = SP ? SP->getLine() : 0;
         
             func_map fm;
+            fm.file = SP ? symbols.intern(SP->getFilename()) : sym_none;
             fm.line_num = line;
-            fm.name = F.getName().str();
-            fm.args = std::vector<param>();
+            fm.name = symbols.intern(F.getName());
 
-            current_scope = F.getName().str();
+            shard.scope = fm.name;
 
+            SmallVector<param, 4> args;
             for (auto& Arg : F.args()) {
                 if (DILocalVariable* DV = findArgDebugInfo(&Arg)) {
-                    fm.args.push_back({Arg.getArgNo(), DV->getName().str()});
+                    args.push_back({(int)Arg.getArgNo(), symbols.intern(DV->getName())});
                 } else {
                     // Handle case where debug info isn't available
                     // Use a default name based on argument position
                     std::string defaultName = "arg" + std::to_string(Arg.getArgNo());
-                    fm.args.push_back({Arg.getArgNo(), defaultName});
+                    args.push_back({(int)Arg.getArgNo(), symbols.intern(defaultName)});
                 }
             }
+            fm.args = copy_array<param>(*shard.arena, args);
 
-            functions.push_back(fm);
+            shard.functions.push_back(fm);
+            shard.function_irs.push_back(&F);
+            shard.function_lines.insert(line_key(fm.file, fm.line_num));
         }
 
         DILocalVariable* findArgDebugInfo(Argument* Arg) {
             Function* F = Arg->getParent();
             if (!F->getSubprogram()) return nullptr;
-            
-            unsigned ArgNo = Arg->getArgNo();
-            
-            for (BasicBlock& BB : *F) {
-                for (Instruction& I : BB) {
-                    if (DbgDeclareInst* DDI = dyn_cast<DbgDeclareInst>(&I)) {
-                        DILocalVariable* DV = DDI->getVariable();
-                        if (DV && DV->getArg() == ArgNo + 1) {
-                            return DV;
-                        }
-                    }
-                }
-            }
-            return nullptr;
+
+            const FunctionDebugVars &vars = debugVarsFor(F);
+            unsigned ArgNo = Arg->getArgNo() + 1;
+            if (DILocalVariable *DV = vars.declared_params.lookup(ArgNo)) return DV;
+            return vars.value_params.lookup(ArgNo);
         }
 
-        void printDbgValueInfo(const DbgDeclareInst* DDI) {
+        void printDbgValueInfo(FactShard &shard, const DbgDeclareInst* DDI) {
             if (!DDI) return;
             
             DILocalVariable* Var = DDI->getVariable();
             DILocation* Loc = DDI->getDebugLoc().get();
             var_map vm;
             if (Var && Loc) {
-                varNames[DDI->getAddress()] = Var->getName().str();
-                debugVars[DDI->getAddress()] = Var;
+                vm.name = symbols.intern(Var->getName());
+                shard.var_names[DDI->getAddress()] = vm.name;
+                shard.declared_vars[DDI->getAddress()] = Var;
 
-                vm.name = Var->getName().str();
-                vm.scope = current_scope;
+                vm.scope = shard.scope;
+                vm.file = symbols.intern(Loc->getFilename());
                 vm.defined_at_line = Loc->getLine();
                 vm.gets_value_infos = std::vector<get_list>();
-                variable_infos.push_back(vm);
+                shard.addVariable(vm);
             }
         }
 
-        std::string getVariableName(Value* V) {
-            if (varNames.count(V)) {
-                return varNames[V];
+        symbol getVariableName(FactShard &shard, Value* V) {
+            auto it = shard.var_names.find(V);
+            if (it != shard.var_names.end()) {
+                return it->second;
+            }
+            it = varNames.find(V);
+            if (it != varNames.end()) {
+                return it->second;
             }
             
             // Try to get name from debug info for arrays
             if (GetElementPtrInst* GEP = dyn_cast<GetElementPtrInst>(V)) {
-                Value* PtrOp = GEP->getPointerOperand();
-                if (debugVars.count(PtrOp)) {
-                    return debugVars[PtrOp]->getName().str();
+                if (DILocalVariable *Var = shard.declared_vars.lookup(GEP->getPointerOperand())) {
+                    return symbols.intern(Var->getName());
                 }
             }
             
-            return "";
+            return sym_none;
         }
 
-        void traceStoreValue(StoreInst* SI) {
+        void traceStoreValue(FactShard &shard, StoreInst* SI) {
             // Guard against null StoreInst
             if (!SI) return;
             
@@ -124,8 +162,8 @@ namespace {
             // Guard against null operands
             if (!PtrOp || !ValOp) return;
             
-            std::string varName = getVariableName(PtrOp);
-            if (!varName.empty()) {
+            symbol varName = getVariableName(shard, PtrOp);
+            if (varName != sym_none) {
                 const DebugLoc &DL = SI->getDebugLoc();
                 DILocation* Loc = DL.get();
                 
@@ -138,78 +176,63 @@ namespace {
                 
                 unsigned Line = DL.getLine();
                 
-                // Guard against file open failures
-                std::ifstream sourceFile(File.str());
-                if (!sourceFile.is_open()) return;
-                
-                std::string sourceLine;
-                unsigned currentLine = 1;
+                // Guard against unreadable files and lines past the end
+                Optional<StringRef> sourceLine = sources.getLine(File, Line);
+                if (!sourceLine) return;
                 
-                // Read until we find the line we want
-                while (std::getline(sourceFile, sourceLine) && currentLine < Line) {
-                    currentLine++;
+                // Now it's safe to process the line. While shards are
+                // collected only globals are in variable_infos, and a global
+                // wins over a local of the same name.
+                FactShard::StoreFact fact;
+                fact.global = true;
+                fact.variable = find_variable_index_in_variable_infos(varName, shard.scope);
+                if (fact.variable == -1) {
+                    fact.global = false;
+                    fact.variable = shard.findVariable(varName);
                 }
-                
-                // Guard against not finding the line
-                if (currentLine != Line) {
-                    sourceFile.close();
-                    return;
-                }
-                
-                // Now it's safe to process the line
-                int v = find_variable_index_in_variable_infos(varName, current_scope);
-                if (v != -1) {
-                    var_map vm = variable_infos[v];
-                    get_list gl;
+                if (fact.variable != -1) {
+                    get_list &gl = fact.gets;
+                    LineKey key = lineKeyOf(shard, DL, *SI->getFunction());
+                    gl.file = key.file;
                     gl.gets_at_line = Line;
-                    line_map lm = variables_per_line[find_line_index_in_variables_per_line(Line)];
-                    gl.vars = lm;
-                    gl.vars.scope = current_scope;
+                    gl.line = find_line_index_in_variables_per_line(key);
+                    gl.scope = shard.scope;
                     
-                    if(lm.vars.size() > 1) {
-                        if(find_function_index_in_function_calls_line(Line) != -1) {
-                            gl.type = "func";
+                    // Calls and functions of earlier shards on this line are
+                    // checked when the shard is merged.
+                    if(vars_of(gl).size() > 1) {
+                        if(shard.call_lines.count(line_key(gl.file, Line))) {
+                            gl.type = get_func;
                         } else {
-                            gl.type = "var";
+                            gl.type = get_var;
+                            fact.check_calls = true;
                         }
                     } else {
-                        if(find_function_index_in_functions_line(Line) != -1) {
-                            gl.type = "param";
+                        if(shard.function_lines.count(line_key(gl.file, Line))) {
+                            gl.type = get_param;
                         } else {
-                            gl.type = "var";
+                            gl.type = get_var;
+                            fact.check_functions = true;
                         }
                     }
                     
-                    // Guard against invalid source line format
-                    vector<string> temp = split(sourceLine, '=');
-                    if (temp.size() < 2) return;
+                    // Guard against invalid source line format: the code is
+                    // what follows the first '=', up to the next one, and
+                    // there has to be something after it.
+                    size_t assign = sourceLine->find('=');
+                    if (assign == StringRef::npos || assign + 1 == sourceLine->size()) return;
                     
-                    gl.code = temp[1];
-                    vm.gets_value_infos.push_back(gl);
-                    variable_infos[v] = vm;
+                    gl.code = sourceLine->drop_front(assign + 1).split('=').first;
+                    shard.stores.push_back(std::move(fact));
                 }
-                
-                sourceFile.close();
-            }
-        }
-
-        vector<string> split(string str, char delimiter) {
-            vector<string> internal;
-            stringstream ss(str); // Turn the string into a stream.
-            string tok;
-            
-            while(getline(ss, tok, delimiter)) {
-                internal.push_back(tok);
             }
-            
-            return internal;
         }
 
-        std::string getArgValue(Value* Arg, Function* CalledF = nullptr) {
+        symbol getArgValue(FactShard &shard, Value* Arg, Function* CalledF = nullptr) {
             // Handle string literals
 
             if (ConstantInt* CI = dyn_cast<ConstantInt>(Arg)) {
-                return std::to_string(CI->getSExtValue());
+                return symbols.intern(std::to_string(CI->getSExtValue()));
             }
 
             if (GEPOperator* GEP = dyn_cast<GEPOperator>(Arg)) {
@@ -217,7 +240,7 @@ namespace {
                     if (GV->hasInitializer()) {
                         if (ConstantDataArray* CDA = dyn_cast<ConstantDataArray>(GV->getInitializer())) {
                             if (CDA->isCString()) {
-                                return "\"" + CDA->getAsCString().str() + "\"";
+                                return symbols.intern("\"" + CDA->getAsCString().str() + "\"");
                             }
                         }
                     }
@@ -228,26 +251,21 @@ namespace {
             if (GetElementPtrInst* GEP = dyn_cast<GetElementPtrInst>(Arg)) {
                 Value* PtrOp = GEP->getPointerOperand();
                 if (AllocaInst* AI = dyn_cast<AllocaInst>(PtrOp)) {
-                    if (debugVars.count(AI)) {
-                        return debugVars[AI]->getName().str();
+                    if (DILocalVariable *Var = shard.declared_vars.lookup(AI)) {
+                        return symbols.intern(Var->getName());
                     }
                 }
             }
             
             // Handle regular variables
             if (LoadInst* LI = dyn_cast<LoadInst>(Arg)) {
-                std::string varName = getVariableName(LI->getPointerOperand());
-                if (!varName.empty()) {
+                symbol varName = getVariableName(shard, LI->getPointerOperand());
+                if (varName != sym_none) {
                     return varName;
                 }
             }
             
-            std::string varName = getVariableName(Arg);
-            if (!varName.empty()) {
-                return varName;
-            }
-            
-            return "";
+            return getVariableName(shard, Arg);
         }
 
         Function* resolveFunctionPointer(Value* V) {
@@ -292,7 +310,7 @@ namespace {
             return nullptr;
         }
 
-        void handleFunctionCall(CallInst* CI) {
+        void handleFunctionCall(FactShard &shard, CallInst* CI) {
             Function* DirectF = CI->getCalledFunction();
             Function* F = DirectF;
             
@@ -307,60 +325,193 @@ namespace {
             
             func_call_map fcm;
             if (CI->getDebugLoc()) {
-                fcm.name = F->getName().str();
-                fcm.args = std::vector<param>();
+                fcm.name = symbols.intern(F->getName());
                 
+                SmallVector<param, 4> args;
                 int ii = 0;
                 for (Use &U : CI->args()) {
-                    std::string argValue = getArgValue(U.get(), F);
-                    if (argValue.empty()) {
-                        fcm.args.push_back({-1, "unknown"});
+                    symbol argValue = getArgValue(shard, U.get(), F);
+                    if (argValue == sym_none) {
+                        args.push_back({-1, sym_unknown});
                     } else {
-                        fcm.args.push_back({ii, argValue});
+                        args.push_back({ii, argValue});
                         ii++;
                     }
                 }
+                fcm.args = copy_array<param>(*shard.arena, args);
                 
-                fcm.scope = current_scope;
+                fcm.scope = shard.scope;
+                fcm.file = symbols.intern(CI->getDebugLoc()->getFilename());
                 fcm.line = CI->getDebugLoc().getLine();
-                function_calls.push_back(fcm);
+                shard.calls.push_back(fcm);
+                shard.call_insts.push_back(CI);
+                shard.call_targets.push_back(F);
+                shard.call_lines.insert(line_key(fcm.file, fcm.line));
             }
         }
 
-        void processInstruction(Instruction* I) {
+        void processInstruction(FactShard &shard, Instruction* I) {
             if (DbgDeclareInst* DDI = dyn_cast<DbgDeclareInst>(I)) {
-                printDbgValueInfo(DDI);
+                printDbgValueInfo(shard, DDI);
             }
             else if (StoreInst* SI = dyn_cast<StoreInst>(I)) {
-                traceStoreValue(SI);
+                traceStoreValue(shard, SI);
             }
             else if (CallInst* CI = dyn_cast<CallInst>(I)) {
-                handleFunctionCall(CI);
+                handleFunctionCall(shard, CI);
             }
         }
 
         std::vector<unsigned int> targetLines = {11, 12, 13}; // Example line numbers
-        std::map<unsigned int, std::set<std::string>> lineToVars;
-
-        // Helper function to find debug declare instruction for a value
-        const DbgDeclareInst* findDbgDeclare(const Value *V) {
-            const Function *F = nullptr;
-            if (const Instruction *I = dyn_cast<Instruction>(V))
-                F = I->getFunction();
-            else if (const Argument *Arg = dyn_cast<Argument>(V))
-                F = Arg->getParent();
-            
-            if (!F) return nullptr;
+        // Where a line record sits: the file and line, and the function the
+        // code on it belongs to (global for declarations outside any).
+        struct LineKey {
+            symbol file = sym_none;
+            unsigned int line = 0;
+            symbol scope = sym_none;
+
+            bool operator==(const LineKey &other) const {
+                return file == other.file && line == other.line && scope == other.scope;
+            }
+            // By id, for lookups only; the table itself is in line order.
+            bool operator<(const LineKey &other) const {
+                return std::tie(line, file, scope) < std::tie(other.line, other.file, other.scope);
+            }
+        };
+
+        // Line order for the table: by line, then file and function name, so
+        // it does not depend on the order names were interned in.
+        bool lineOrder(const LineKey &a, const LineKey &b) const {
+            if (a.line != b.line) return a.line < b.line;
+            if (a.file != b.file) return symbols.name(a.file) < symbols.name(b.file);
+            return a.scope != b.scope && symbols.name(a.scope) < symbols.name(b.scope);
+        }
+
+        // Innermost loop around a source line: its depth (0 when the line is
+        // not in a loop) and the lines the loop spans.
+        struct LoopLine {
+            unsigned int depth = 0;
+            unsigned int loop_start = 0;
+            unsigned int loop_end = 0;
+        };
+
+        struct SeenLine {
+            LineKey key;
+            LoopLine loop;
+        };
+
+        // Lines with debug locations and the variables seen on them, appended
+        // in any order by the sweeps; buildLineTable sorts and dedups them.
+        vector<SeenLine> seen_lines;
+        vector<pair<LineKey, symbol>> line_vars;
+
+        // variables_per_line entry of each line key, sorted for lookups.
+        vector<pair<LineKey, int>> line_lookup;
+        // Loop around each variables_per_line entry, for the debug dump.
+        vector<LoopLine> line_loops;
+
+        // variables_per_line from the collected lines: one record per file,
+        // line and function in line order, its variables in name order as
+        // one slice of a single arena array.
+        void buildLineTable() {
+            llvm::sort(seen_lines, [this](const SeenLine &a, const SeenLine &b) {
+                if (!(a.key == b.key)) return lineOrder(a.key, b.key);
+                return a.loop.depth > b.loop.depth;
+            });
+            seen_lines.erase(std::unique(seen_lines.begin(), seen_lines.end(),
+                                         [](const SeenLine &a, const SeenLine &b) { return a.key == b.key; }),
+                             seen_lines.end());
+            llvm::sort(line_vars, [this](const pair<LineKey, symbol> &a, const pair<LineKey, symbol> &b) {
+                if (!(a.first == b.first)) return lineOrder(a.first, b.first);
+                return a.second != b.second && symbols.name(a.second) < symbols.name(b.second);
+            });
+            line_vars.erase(std::unique(line_vars.begin(), line_vars.end()), line_vars.end());
+
+            SmallVector<variable, 0> names;
+            names.reserve(line_vars.size());
+            for (auto &entry : line_vars) names.push_back({entry.second});
+            ArrayRef<variable> all = copy_array<variable>(arena, names);
+
+            size_t k = 0;
+            for (const SeenLine &seen : seen_lines) {
+                size_t first = k;
+                while (k < line_vars.size() && line_vars[k].first == seen.key) k++;
+
+                line_map lm;
+                lm.file = seen.key.file;
+                lm.line_num = seen.key.line;
+                lm.scope = seen.key.scope;
+                lm.vars = all.slice(first, k - first);
+                lm.part_of_loop = seen.loop.depth > 0;
+                line_lookup.push_back({seen.key, (int)variables_per_line.size()});
+                line_loops.push_back(seen.loop);
+                add_line(lm);
+            }
+            llvm::sort(line_lookup, [](const pair<LineKey, int> &a, const pair<LineKey, int> &b) {
+                return a.first < b.first;
+            });
+            seen_lines = {};
+            line_vars = {};
+        }
+
+        // Debug variables of one function, collected in a single sweep. The
+        // first record for a value (or argument number) wins; dbg.declare
+        // takes precedence over dbg.value.
+        struct FunctionDebugVars {
+            DenseMap<const Value*, DILocalVariable*> declared;
+            DenseMap<const Value*, DILocalVariable*> values;
+            DenseMap<unsigned, DILocalVariable*> declared_params;
+            DenseMap<unsigned, DILocalVariable*> value_params;
+
+            void addDeclare(const Value *Address, DILocalVariable *Var) {
+                if (Address) declared.insert({Address, Var});
+                if (Var && Var->getArg()) declared_params.insert({Var->getArg(), Var});
+            }
+
+            void addValue(const Value *V, DILocalVariable *Var) {
+                if (V) values.insert({V, Var});
+                if (Var && Var->getArg()) value_params.insert({Var->getArg(), Var});
+            }
 
+            // The debug variable describing a value of this function.
+            DILocalVariable *find(const Value *V) const {
+                if (!isa<Instruction>(V) && !isa<Argument>(V)) return nullptr;
+                auto it = declared.find(V);
+                if (it != declared.end()) return it->second;
+                return values.lookup(V);
+            }
+        };
+        DenseMap<const Function*, std::unique_ptr<FunctionDebugVars>> functionDebugVars;
+
+        // Once the facts are collected every defined function has its entry,
+        // so the lookups of the parallel second sweep never insert.
+        const FunctionDebugVars &debugVarsFor(const Function *F) {
+            auto it = functionDebugVars.find(F);
+            if (it != functionDebugVars.end()) return *it->second;
+            return *(functionDebugVars[F] = collectDebugVars(F));
+        }
+
+        static std::unique_ptr<FunctionDebugVars> collectDebugVars(const Function *F) {
+            auto vars = std::make_unique<FunctionDebugVars>();
             for (const BasicBlock &BB : *F) {
                 for (const Instruction &I : BB) {
+#if LLVM_VERSION_MAJOR >= 19
+                    for (const DbgVariableRecord &DVR : filterDbgVars(I.getDbgRecordRange())) {
+                        if (DVR.isDbgDeclare()) {
+                            vars->addDeclare(DVR.getAddress(), DVR.getVariable());
+                        } else {
+                            for (const Value *V : DVR.location_ops()) vars->addValue(V, DVR.getVariable());
+                        }
+                    }
+#endif
                     if (const DbgDeclareInst *DDI = dyn_cast<DbgDeclareInst>(&I)) {
-                        if (DDI->getAddress() == V)
-                            return DDI;
+                        vars->addDeclare(DDI->getAddress(), DDI->getVariable());
+                    } else if (const DbgValueInst *DVI = dyn_cast<DbgValueInst>(&I)) {
+                        for (const Value *V : DVI->location_ops()) vars->addValue(V, DVI->getVariable());
                     }
                 }
             }
-            return nullptr;
+            return vars;
         }
 
         void trackGlobalVariables(Module &M) {
@@ -368,33 +519,257 @@ namespace {
                 if (DIGlobalVariableExpression* DIGVE = dyn_cast_or_null<DIGlobalVariableExpression>(
                         GV.getMetadata(LLVMContext::MD_dbg))) {
                     DIGlobalVariable *DGV = DIGVE->getVariable();
-                    unsigned line = DGV->getLine();
-                    lineToVars[line].insert(DGV->getName().str());
+                    LineKey key{symbols.intern(DGV->getFilename()), DGV->getLine(), sym_global};
+                    seen_lines.push_back({key, false});
+                    line_vars.push_back({key, symbols.intern(DGV->getName())});
                 }
             }
         }
 
-        unordered_map<unsigned int, int> loop_map;
+        // One sweep over F. A line is in a loop if any of its instructions
+        // is; with several, the deepest loop wins. Lines F shares with an
+        // earlier function (macros, one-line functions) take F's answer.
+        void computeLoopLines(FactShard &shard, Function &F, LoopInfo &LI) {
+            std::map<const Loop*, pair<unsigned int, unsigned int>> ranges;
+            std::map<unsigned int, const Loop*> innermost;
 
-        void getVariableNamesAtLine(const Instruction &I,  Function &F, LoopInfo &LI) {
-            const DebugLoc &DL = I.getDebugLoc();
-            if (!DL) return;
+            for (BasicBlock &BB : F) {
+                const Loop *L = LI.getLoopFor(&BB);
+                for (Instruction &I : BB) {
+                    if (!I.getDebugLoc()) continue;
+                    unsigned int line = I.getDebugLoc().getLine();
+
+                    auto inserted = innermost.insert({line, L});
+                    if (L && (!inserted.first->second || inserted.first->second->getLoopDepth() < L->getLoopDepth()))
+                        inserted.first->second = L;
+
+                    // A loop's range covers its subloops too.
+                    for (const Loop *outer = L; outer; outer = outer->getParentLoop()) {
+                        auto range = ranges.insert({outer, {line, line}}).first;
+                        range->second.first = std::min(range->second.first, line);
+                        range->second.second = std::max(range->second.second, line);
+                    }
+                }
+            }
+
+            for (auto &entry : innermost) {
+                LoopLine &loop_line = shard.loop_lines[entry.first];
+                loop_line = LoopLine();
+                if (const Loop *L = entry.second) {
+                    loop_line.depth = L->getLoopDepth();
+                    loop_line.loop_start = ranges[L].first;
+                    loop_line.loop_end = ranges[L].second;
+                }
+            }
+        }
+
+        static LoopLine loopAtLine(const FactShard &shard, unsigned int sourceLine) {
+            auto it = shard.loop_lines.find(sourceLine);
+            return it == shard.loop_lines.end() ? LoopLine() : it->second;
+        }
+
+        // What one function adds to the fact tables. Functions are collected
+        // in parallel, each into its own shard, and the shards are merged in
+        // module order so the tables come out as a serial sweep builds them.
+        struct FactShard {
+            // First sweep: debug variables, loops, variables per line.
+            std::unique_ptr<FunctionDebugVars> debug_vars;
+            std::map<unsigned int, LoopLine> loop_lines;
+            vector<SeenLine> lines;
+            vector<pair<LineKey, symbol>> line_vars;
+            DenseMap<const DISubprogram*, symbol> subprograms;
+            DenseMap<const DIScope*, symbol> files;
+
+            // Second sweep: the function, its locals and calls, and the
+            // values stored into variables. Their arrays go into `arena`,
+            // which the merge hands over to the tables.
+            std::unique_ptr<BumpPtrAllocator> arena = std::make_unique<BumpPtrAllocator>();
+            symbol scope = sym_global;
+            DenseMap<const Value*, symbol> var_names;
+            DenseMap<const Value*, DILocalVariable*> declared_vars;
+            vector<func_map> functions;
+            vector<var_map> variables;
+            unordered_map<symbol, int> variable_index;      // name, first entry
+            vector<func_call_map> calls;
+            vector<const Function*> function_irs;           // the IR function of each of functions
+            vector<const CallInst*> call_insts;             // the call of each of calls
+            vector<const Function*> call_targets;           // and the function it resolved to
+            std::set<uint64_t> function_lines;     // line_key(file, line)
+            std::set<uint64_t> call_lines;
+
+            // A get_list for a global (index in variable_infos) or for one
+            // of `variables`. The check_* flags leave its type to the merge,
+            // which can see the calls and functions of earlier shards.
+            struct StoreFact {
+                bool global = false;
+                int variable = -1;
+                get_list gets;
+                bool check_calls = false;
+                bool check_functions = false;
+            };
+            vector<StoreFact> stores;
+
+            void addVariable(const var_map &vm) {
+                variable_index.insert({vm.name, (int)variables.size()});
+                variables.push_back(vm);
+            }
+
+            int findVariable(symbol name) const {
+                auto it = variable_index.find(name);
+                return it == variable_index.end() ? -1 : it->second;
+            }
+        };
+
+        // Runs work(i) for every i below count, on a thread pool unless
+        // -seminal-threads=1.
+        void runParallel(size_t count, function_ref<void(size_t)> work) {
+            if (SeminalThreads == 1 || count < 2) {
+                for (size_t i = 0; i < count; ++i) work(i);
+                return;
+            }
+#if LLVM_VERSION_MAJOR >= 19
+            DefaultThreadPool pool(hardware_concurrency(SeminalThreads));
+#else
+            ThreadPool pool(hardware_concurrency(SeminalThreads));
+#endif
+            for (size_t i = 0; i < count; ++i) {
+                pool.async([&work, i] { work(i); });
+            }
+            pool.wait();
+        }
+
+        // First sweep over one function.
+        void collectLineFacts(FactShard &shard, Function &F) {
+            shard.debug_vars = collectDebugVars(&F);
+            DominatorTree DT(F);
+            LoopInfo LI(DT);
+            computeLoopLines(shard, F, LI);
+
+            for (BasicBlock &BB : F) {
+                for (Instruction &I : BB) {
+                    getVariableNamesAtLine(shard, I);
+                }
+            }
+        }
+
+        void mergeLineFacts(Function &F, FactShard &shard) {
+            functionDebugVars[&F] = std::move(shard.debug_vars);
+            seen_lines.insert(seen_lines.end(), shard.lines.begin(), shard.lines.end());
+            line_vars.insert(line_vars.end(), shard.line_vars.begin(), shard.line_vars.end());
+            shard.lines = {};
+            shard.line_vars = {};
+        }
+
+        // Second sweep over one function.
+        void collectFunctionFacts(FactShard &shard, Function &F) {
+            printFunctionHeader(shard, F);
+
+            for (BasicBlock& BB : F) {
+                for (Instruction& I : BB) {
+                    processInstruction(shard, &I);
+                }
+            }
+        }
+
+        void mergeFunctionFacts(FactShard &shard) {
+            for (FactShard::StoreFact &fact : shard.stores) {
+                get_list &gl = fact.gets;
+                if (fact.check_calls && find_function_index_in_function_calls_line(gl.file, gl.gets_at_line) != -1) {
+                    gl.type = get_func;
+                }
+                if (fact.check_functions && find_function_index_in_functions_line(gl.file, gl.gets_at_line) != -1) {
+                    gl.type = get_param;
+                }
+                if (fact.global) {
+                    variable_infos[fact.variable].gets_value_infos.push_back(gl);
+                } else {
+                    shard.variables[fact.variable].gets_value_infos.push_back(gl);
+                }
+            }
 
-            unsigned int currentLine = DL.getLine();
-            auto &varNames = lineToVars[currentLine];
+            for (size_t k = 0; k < shard.functions.size(); ++k) {
+                function_ids.insert({shard.function_irs[k], (int)functions.size()});
+                add_function(shard.functions[k]);
+            }
+            for (const var_map &vm : shard.variables) add_variable_info(vm);
+            for (size_t k = 0; k < shard.calls.size(); ++k) {
+                call_index[shard.call_insts[k]] = function_calls.size();
+                if (!shard.call_insts[k]->getCalledFunction())
+                    resolved_calls.push_back({(int)function_calls.size(), shard.call_targets[k]});
+                add_function_call(shard.calls[k]);
+            }
+            shard_arenas.push_back(std::move(shard.arena));
+        }
 
-            if (isSourceLineInLoop(currentLine, F, LI)) {
-                // errs()<<"Line "<<currentLine<<" is in a loop\n";
-                loop_map[currentLine] = 1;
-            }else{
-                // errs()<<"Line "<<currentLine<<" is not in a loop\n";
-                loop_map[currentLine] = 0;
+        // functions entry of each defined function, and function_calls entry
+        // of each recorded call instruction.
+        DenseMap<const Function*, int> function_ids;
+        DenseMap<const CallBase*, int> call_index;
+        // Calls through function pointers the sweep resolved, with the
+        // function they resolved to.
+        vector<pair<int, const Function*>> resolved_calls;
+
+        // Fills callers: the direct calls of each function from its edges in
+        // the call graph, and the calls through function pointers the sweep
+        // resolved, which the graph only knows as calls to unknown code.
+        void buildCallerIndex(Module &M, ModuleAnalysisManager &AM) {
+            callers.assign(functions.size(), {});
+
+            CallGraph &CG = AM.getResult<CallGraphAnalysis>(M);
+            for (auto &node : CG) {
+                if (!node.first || node.first->isDeclaration()) continue;
+                for (auto &record : *node.second) {
+                    auto callee = function_ids.find(record.second->getFunction());
+                    if (callee == function_ids.end() || !record.first) continue;
+                    auto site = call_index.find(cast<CallBase>(&*record.first.getValue()));
+                    if (site != call_index.end()) callers[callee->second].push_back(site->second);
+                }
+            }
+            for (auto &call : resolved_calls) {
+                auto callee = function_ids.find(call.second);
+                if (callee != function_ids.end()) callers[callee->second].push_back(call.first);
             }
+            // In module order, as the call sites were recorded.
+            for (vector<int> &sites : callers) llvm::sort(sites);
+        }
+
+        // The function a location in F belongs to, by the subprogram of its
+        // scope, so code inlined into F keeps its own function. F's own code
+        // goes by F's name, as its facts do.
+        static StringRef subprogramName(const DebugLoc &DL, const Function &F) {
+            DISubprogram *SP = DL->getScope()->getSubprogram();
+            if (SP == F.getSubprogram()) return F.getName();
+            StringRef name = SP->getLinkageName();
+            return name.empty() ? SP->getName() : name;
+        }
+
+        symbol scopeOf(FactShard &shard, const DebugLoc &DL, const Function &F) {
+            auto inserted = shard.subprograms.try_emplace(DL->getScope()->getSubprogram(), sym_none);
+            if (inserted.second) inserted.first->second = symbols.intern(subprogramName(DL, F));
+            return inserted.first->second;
+        }
+
+        LineKey lineKeyOf(FactShard &shard, const DebugLoc &DL, const Function &F) {
+            auto inserted = shard.files.try_emplace(DL->getScope(), sym_none);
+            if (inserted.second) inserted.first->second = symbols.intern(DL->getFilename());
+            return {inserted.first->second, DL.getLine(), scopeOf(shard, DL, F)};
+        }
+
+        void getVariableNamesAtLine(FactShard &shard, const Instruction &I) {
+            const DebugLoc &DL = I.getDebugLoc();
+            if (!DL) return;
+
+            LineKey current = lineKeyOf(shard, DL, *I.getFunction());
+            if (shard.lines.empty() || !(shard.lines.back().key == current))
+                shard.lines.push_back({current, loopAtLine(shard, current.line)});
+            auto addVariable = [&](const LineKey &key, StringRef name) {
+                shard.line_vars.push_back({key, symbols.intern(name)});
+            };
 
             // Check for DbgDeclareInst directly
             if (const DbgDeclareInst *DDI = dyn_cast<DbgDeclareInst>(&I)) {
                 if (DILocalVariable *DIVar = DDI->getVariable()) {
-                    varNames.insert(DIVar->getName().str());
+                    addVariable(current, DIVar->getName());
                 }
             }
 
@@ -405,15 +780,13 @@ namespace {
                     if (DIGlobalVariableExpression* DIGVE = dyn_cast_or_null<DIGlobalVariableExpression>(
                             GV->getMetadata(LLVMContext::MD_dbg))) {
                         DIGlobalVariable *DGV = DIGVE->getVariable();
-                        varNames.insert(DGV->getName().str());
+                        addVariable(current, DGV->getName());
                     }
                 }
                 // Check for local variables
                 if (const Value *V = LI->getPointerOperand()) {
-                    if (const DbgDeclareInst *DDI = findDbgDeclare(V)) {
-                        if (DILocalVariable *DIVar = DDI->getVariable()) {
-                            varNames.insert(DIVar->getName().str());
-                        }
+                    if (DILocalVariable *DIVar = shard.debug_vars->find(V)) {
+                        addVariable(current, DIVar->getName());
                     }
                 }
             }
@@ -425,15 +798,13 @@ namespace {
                     if (DIGlobalVariableExpression* DIGVE = dyn_cast_or_null<DIGlobalVariableExpression>(
                             GV->getMetadata(LLVMContext::MD_dbg))) {
                         DIGlobalVariable *DGV = DIGVE->getVariable();
-                        varNames.insert(DGV->getName().str());
+                        addVariable(current, DGV->getName());
                     }
                 }
                 // Check for local variables
                 if (const Value *V = SI->getPointerOperand()) {
-                    if (const DbgDeclareInst *DDI = findDbgDeclare(V)) {
-                        if (DILocalVariable *DIVar = DDI->getVariable()) {
-                            varNames.insert(DIVar->getName().str());
-                        }
+                    if (DILocalVariable *DIVar = shard.debug_vars->find(V)) {
+                        addVariable(current, DIVar->getName());
                     }
                 }
             }
@@ -442,207 +813,439 @@ namespace {
             for (const Use &U : I.operands()) {
                 if (const Value *V = U.get()) {
                     if (const AllocaInst *AI = dyn_cast<AllocaInst>(V)) {
-                        if (const DbgDeclareInst *DDI = findDbgDeclare(AI)) {
-                            if (DILocalVariable *DIVar = DDI->getVariable()) {
-                                // Get the line number from the debug location of the alloca instruction
-                                if (const DebugLoc &AllocaLoc = AI->getDebugLoc()) {
-                                    lineToVars[AllocaLoc.getLine()].insert(DIVar->getName().str());
-                                }
-                                varNames.insert(DIVar->getName().str());
+                        if (DILocalVariable *DIVar = shard.debug_vars->find(AI)) {
+                            // Get the line number from the debug location of the alloca instruction
+                            if (const DebugLoc &AllocaLoc = AI->getDebugLoc()) {
+                                LineKey declared = lineKeyOf(shard, AllocaLoc, *AI->getFunction());
+                                shard.lines.push_back({declared, loopAtLine(shard, declared.line)});
+                                addVariable(declared, DIVar->getName());
                             }
+                            addVariable(current, DIVar->getName());
                         }
                     }
                 }
             }
         }
 
-        bool isSourceLineInLoop(unsigned int sourceLine, Function &F, LoopInfo &LI) {
-            for (BasicBlock &BB : F) {
-                for (Instruction &I : BB) {
-                    if (!I.getDebugLoc()) continue;
-                    
-                    unsigned int currentLine = I.getDebugLoc().getLine();
-                    
-                    // If we found an instruction at our target line
-                    if (currentLine == sourceLine) {
-                        // Need to pass the address of BB to getLoopFor
-                        Loop* L = LI.getLoopFor(&BB);
-                        if (!L) continue;
-                        
-                        // Get all the blocks in the loop
-                        auto loopBlocks = L->getBlocks();  // This returns an ArrayRef
-                        
-                        // Get the line range of the loop
-                        unsigned loopStartLine = UINT_MAX;
-                        unsigned loopEndLine = 0;
-                        
-                        for (BasicBlock* loopBB : loopBlocks) {
-                            for (Instruction &loopInst : *loopBB) {
-                                if (loopInst.getDebugLoc()) {
-                                    unsigned instLine = loopInst.getDebugLoc().getLine();
-                                    loopStartLine = std::min(loopStartLine, instLine);
-                                    loopEndLine = std::max(loopEndLine, instLine);
-                                }
-                            }
-                        }
-                        
-                        // Check if our source line falls within the loop's range
-                        if (sourceLine >= loopStartLine && sourceLine <= loopEndLine) {
-                            return true;
-                        }
-                    }
-                }
+        // A source line with conditional branches, in one file and function,
+        // labelled with the first branch id on it.
+        struct BranchLine {
+            LineKey key;
+            string branch_id;
+            vector<BranchInst*> branches;
+        };
+
+        // One query per branch line, in line order.
+        vector<BranchLine> readBranchInfo(Module &M, ModuleAnalysisManager &AM) {
+            std::map<LineKey, BranchLine> lines;
+            for (const BranchInfo &branch : AM.getResult<BranchInfoAnalysis>(M)) {
+                const DebugLoc &DL = branch.branch->getDebugLoc();
+                LineKey key{symbols.intern(branch.filepath), branch.src_lno, symbols.intern(subprogramName(DL, *branch.branch->getFunction()))};
+                auto inserted = lines.insert({key, BranchLine{key, "br_" + std::to_string(branch.branch_id), {}}});
+                vector<BranchInst*> &branches = inserted.first->second.branches;
+                if (std::find(branches.begin(), branches.end(), branch.branch) == branches.end())
+                    branches.push_back(branch.branch);
             }
-            return false;
-        }
 
-        std::vector<pair<int, string>> readBranchInfo() {
-            std::ifstream file("branch_info.txt");
-            std::set<unsigned int> uniqueLines;  // Using set for unique numbers
-            vector<string> branch_id;
-            std::string line;
+            vector<BranchLine> result;
+            for (auto &entry : lines) result.push_back(std::move(entry.second));
+            llvm::sort(result, [this](const BranchLine &a, const BranchLine &b) { return lineOrder(a.key, b.key); });
+            return result;
+        }
 
-            if (!file.is_open()) {
-                errs() << "Error: Could not open branch_info.txt\n";
-                return std::vector<pair<int,string>>();
+        // function that finds the index of variable in variable_infos with name=n
+        // and scope=s; a global called n wins if it was added first
+        int find_variable_index_in_variable_infos(symbol n, symbol s) {
+            int found = -1;
+            for (symbol scope : {symbol(sym_global), s}) {
+                auto it = variable_index.find(variable_key(n, scope));
+                if (it != variable_index.end() && (found == -1 || it->second < found)) found = it->second;
             }
+            return found;
+        }
 
-            while (std::getline(file, line)) {
-                // Skip empty lines
-                if (line.empty()) continue;
+        // function that finds the index of line in variables_per_line for
+        // the file, line and function in `key`
+        int find_line_index_in_variables_per_line(const LineKey &key) const {
+            auto it = std::lower_bound(line_lookup.begin(), line_lookup.end(), key,
+                                       [](const pair<LineKey, int> &entry, const LineKey &k) { return entry.first < k; });
+            return it == line_lookup.end() || !(it->first == key) ? -1 : it->second;
+        }
 
-                // Find position of first comma
-                size_t pos = line.find(',');
-                if (pos == std::string::npos) continue;
+        // function to find the index of function in functions with name=n
+        int find_function_index_in_functions(symbol n) {
+            auto it = function_index.find(n);
+            return it == function_index.end() ? -1 : it->second;
+        }
 
-                // Extract the part after the comma and trim whitespace
-                std::string numberPart = line.substr(pos + 1);
-                pos = numberPart.find(',');
-                if (pos == std::string::npos) continue;
+        // function to find the index of function in functions with line=l
+        int find_function_index_in_functions_line(symbol file, int l) {
+            const vector<int> &found = lookup_all(functions_by_line, line_key(file, l));
+            return found.empty() ? -1 : found.front();
+        }
 
-                // Extract the number and trim whitespace
-                std::string numberStr = numberPart.substr(0, pos);
-                // Remove leading/trailing spaces
-                numberStr.erase(0, numberStr.find_first_not_of(" "));
-                numberStr.erase(numberStr.find_last_not_of(" ") + 1);
+        int find_function_index_in_function_calls(symbol n) {
+            const vector<int> &found = lookup_all(calls_by_name, n);
+            return found.empty() ? -1 : found.front();
+        }
 
-                // Convert to integer and add to set
-                unsigned int lineNum = std::stoi(numberStr);
-                uniqueLines.insert(lineNum);
+        // function to find the index of function in function_calls with line=l
+        int find_function_index_in_function_calls_line(symbol file, int l) {
+            const vector<int> &found = lookup_all(calls_by_line, line_key(file, l));
+            return found.empty() ? -1 : found.front();
+        }
 
-                // Extract the branch id
-                // find position of first ':'
-                size_t pos2 = line.find(':');
-                if (pos2 == std::string::npos) continue;
+        // Input sources that reach a (variable, scope) pair in do_analysis.
+        enum InputSource : unsigned {
+            FromScanf = 1,
+            FromFopen = 2,
+            FromFread = 4,
+            FromGetc = 8,
+            FromParameter = 16,
+        };
+        // Sources that make do_analysis report a branch; getc alone doesn't.
+        static constexpr unsigned ReportedSources = FromScanf | FromFopen | FromFread;
+
+        // A (variable, scope) pair as do_analysis sees it, with the pairs it
+        // would recurse into. `sources` are the ones found at this node,
+        // `reaches` the ones of everything reachable from it.
+        struct VariableNode {
+            symbol name;
+            symbol scope;
+            bool expanded = false;
+            bool known = false;         // found in variable_infos
+            vector<int> deps;
+            unsigned sources = 0;
+            unsigned reaches = 0;
+            bool summarized = false;
+        };
+        vector<VariableNode> variable_nodes;
+        unordered_map<uint64_t, int> variable_node_index;
+
+        int variableNode(symbol var_name, symbol scope) {
+            auto inserted = variable_node_index.insert({variable_key(var_name, scope), variable_nodes.size()});
+            if (inserted.second) variable_nodes.push_back({var_name, scope});
+            return inserted.first->second;
+        }
 
-                // Extract the part before the ':'
-                std::string branch_id_str = line.substr(0, pos2);
-                branch_id.push_back(branch_id_str);
+        // Fills in the node's edges, the same ones do_analysis follows: none
+        // after a scanf in scope, else the call arguments if it is a
+        // parameter, else the variables on the lines it gets its values
+        // from, up to the first line without any.
+        VariableNode &expandVariableNode(int n) {
+            if (variable_nodes[n].expanded) return variable_nodes[n];
+            variable_nodes[n].expanded = true;
 
+            const symbol var_name = variable_nodes[n].name;
+            const symbol scope = variable_nodes[n].scope;
+            int v = find_variable_index_in_variable_infos(var_name, scope);
+            if (v == -1) return variable_nodes[n];
+
+            vector<pair<symbol, symbol>> deps;
+            unsigned sources = 0;
+            for (int fc : lookup_all(calls_by_scope, scope)) {
+                const func_call_map &fcall = function_calls[fc];
+                if (!is_scanf(fcall.name)) continue;
+                for (size_t i = 1; i < fcall.args.size(); i++) {
+                    if (fcall.args[i].name == var_name) sources |= FromScanf;
+                }
             }
 
-            file.close();
-
-            vector<unsigned int> uu = std::vector<unsigned int>(uniqueLines.begin(), uniqueLines.end());
-            std::vector<pair<int, string>> branch_info;
-            for(int i = 0; i < branch_id.size(); i++) {
-                branch_info.push_back({uu[i], branch_id[i]});
+            const var_map &vm = variable_infos[v];
+            if (!sources) {
+                for (int fi : lookup_all(functions_by_line, line_key(vm.file, vm.defined_at_line))) {
+                    const func_map &fm = functions[fi];
+                    int arg_index = 0;
+                    for (auto &pa : fm.args)
+                        if (pa.name == var_name) arg_index = pa.id;
+                    for (int i : callers[fi]) {
+                        const func_call_map &fcm = function_calls[i];
+                        // Calls through a mismatched prototype or with too few arguments.
+                        if ((size_t)arg_index >= fcm.args.size()) continue;
+                        if (fcm.args[arg_index].name == var_name && fcm.scope == scope) continue;
+                        deps.push_back({fcm.args[arg_index].name, fcm.scope});
+                        sources |= FromParameter;
+                    }
+                }
             }
-            return branch_info;
-        }
 
-        // function that finds the index of variable in variable_infos with name=n and scope=s
-        int find_variable_index_in_variable_infos(string n, string s) {
-            for (int i = 0; i < variable_infos.size(); i++) {
-                if(variable_infos[i].name == n && variable_infos[i].scope == "global") return i;
-                if (variable_infos[i].name == n && variable_infos[i].scope == s) {
-                    return i;
+            if (!sources) {
+                for (auto &gl : vm.gets_value_infos) {
+                    for (int i : lookup_all(calls_by_line, line_key(gl.file, gl.gets_at_line))) {
+                        symbol fname = function_calls[i].name;
+                        if (fname == sym_getc || fname == sym_fgetc) sources |= FromGetc;
+                        else if (fname == sym_fopen) sources |= FromFopen;
+                        else if (fname == sym_fread) sources |= FromFread;
+                        else if (is_scanf(fname)) sources |= FromScanf;
+                    }
+                    ArrayRef<variable> vars = vars_of(gl);
+                    if (vars.size() == 0) break;
+                    for (auto &va : vars) {
+                        if (va.name != var_name) deps.push_back({va.name, gl.scope});
+                    }
                 }
             }
-            return -1;
+
+            vector<int> dep_nodes;
+            for (auto &dep : deps) dep_nodes.push_back(variableNode(dep.first, dep.second));
+            VariableNode &node = variable_nodes[n];
+            node.known = true;
+            node.deps = std::move(dep_nodes);
+            node.sources = sources;
+            return node;
         }
 
-        // function that finds the index of line in variables_per_line with line_num=l
-        int find_line_index_in_variables_per_line(int l) {
-            for (int i = 0; i < variables_per_line.size(); i++) {
-                if (variables_per_line[i].line_num == l) {
-                    return i;
+        // Input sources reachable from `root`, computed once per node. Cycles
+        // (mutually dependent variables, recursive calls) are collapsed with
+        // Tarjan's algorithm, every member of an SCC gets the SCC's summary.
+        unsigned summarize(int root) {
+            if (variable_nodes[root].summarized) return variable_nodes[root].reaches;
+
+            unordered_map<int, pair<int, int>> order;   // node -> (index, lowlink)
+            vector<int> scc_stack;
+            std::set<int> on_stack;
+            vector<pair<int, size_t>> frames = {{root, 0}};
+            int next_index = 0;
+            order[root] = {next_index, next_index};
+            next_index++;
+            scc_stack.push_back(root);
+            on_stack.insert(root);
+
+            while (!frames.empty()) {
+                int n = frames.back().first;
+                size_t &edge = frames.back().second;
+                if (edge < expandVariableNode(n).deps.size()) {
+                    int d = variable_nodes[n].deps[edge++];
+                    if (variable_nodes[d].summarized) continue;
+                    if (!order.count(d)) {
+                        order[d] = {next_index, next_index};
+                        next_index++;
+                        scc_stack.push_back(d);
+                        on_stack.insert(d);
+                        frames.push_back({d, 0});
+                    } else if (on_stack.count(d)) {
+                        order[n].second = std::min(order[n].second, order[d].first);
+                    }
+                    continue;
+                }
+
+                frames.pop_back();
+                if (!frames.empty()) {
+                    int parent = frames.back().first;
+                    order[parent].second = std::min(order[parent].second, order[n].second);
+                }
+                if (order[n].second != order[n].first) continue;
+
+                // n is the root of an SCC, everything it reaches outside the
+                // SCC is summarized already.
+                vector<int> scc;
+                unsigned reaches = 0;
+                int member;
+                do {
+                    member = scc_stack.back();
+                    scc_stack.pop_back();
+                    on_stack.erase(member);
+                    scc.push_back(member);
+                    reaches |= variable_nodes[member].sources;
+                } while (member != n);
+                for (int m : scc) {
+                    for (int d : variable_nodes[m].deps) {
+                        if (variable_nodes[d].summarized) reaches |= variable_nodes[d].reaches;
+                    }
+                }
+                for (int m : scc) {
+                    variable_nodes[m].reaches = reaches;
+                    variable_nodes[m].summarized = true;
                 }
             }
-            return -1;
+            return variable_nodes[root].reaches;
         }
 
-        // function to find the index of function in functions with name=n
-        int find_function_index_in_functions(string n) {
-            for (int i = 0; i < functions.size(); i++) {
-                if (functions[i].name == n) {
-                    return i;
-                }
+        // Expands and summarizes every node a query starting at these
+        // variables can reach, so the queries only read the graph.
+        void prepareVariableNodes(const line_map &vp) {
+            for (const auto &va : vp.vars) {
+                summarize(variableNode(va.name, vp.scope));
             }
-            return -1;
         }
 
-        // function to find the index of function in function_calls with line=l
-        int find_function_index_in_functions_line(int l) {
-            for (int i = 0; i < functions.size(); i++) {
-                if (functions[i].line_num == l) {
-                    return i;
-                }
+        int findVariableNode(symbol var_name, symbol scope) const {
+            auto it = variable_node_index.find(variable_key(var_name, scope));
+            return it == variable_node_index.end() ? -1 : it->second;
+        }
+
+        // One (line, branch id) query and everything do_analysis changes
+        // while answering it. Queries share nothing else, so they run side
+        // by side over the fact tables and the variable graph, which they
+        // only read.
+        struct BranchQuery {
+            LineKey key;
+            int line = 0;
+            string branch_id;
+            DenseSet<uint64_t> visited;                 // variable_key(name, scope)
+            bool seminal = false;       // current branch variable reported
+            unsigned analysis_nodes = 0;
+            bool budget_exhausted = false;
+            BumpPtrAllocator provenance;
+            vector<SeminalFinding> findings;
+        };
+
+        // What do_analysis would have marked visited walking from `root`.
+        void markVisited(BranchQuery &query, int root) {
+            vector<int> stack = {root};
+            while (!stack.empty()) {
+                const VariableNode &node = variable_nodes[stack.back()];
+                stack.pop_back();
+                if (!node.known || !query.visited.insert(variable_key(node.name, node.scope)).second) continue;
+                stack.insert(stack.end(), node.deps.begin(), node.deps.end());
             }
-            return -1;
         }
 
-        int find_function_index_in_function_calls(string n) {
-            for (int i = 0; i < function_calls.size(); i++) {
-                if (function_calls[i].name == n) {
-                    return i;
-                }
+        // One def-use step of an explanation. Steps point at the step before
+        // them, so the chains of one walk share their common prefix, and the
+        // text is only put together when a chain is written out.
+        struct ProvenanceNode {
+            enum Kind { ScanfInScope, Parameter, Argument, Getc, Fopen, Fread, Scanf } kind;
+            symbol var;
+            symbol callee;              // function the parameter belongs to, or the call
+            symbol arg;                 // argument, file or buffer
+            symbol mode;                // fopen mode
+            unsigned line;
+            const ProvenanceNode *parent;
+            mutable bool reported;      // part of a chain already written out
+        };
+
+        static const ProvenanceNode *addStep(BranchQuery &query, ProvenanceNode::Kind kind, symbol var,
+                                             symbol callee, symbol arg, symbol mode,
+                                             unsigned line, const ProvenanceNode *parent) {
+            return new (query.provenance.Allocate<ProvenanceNode>())
+                ProvenanceNode{kind, var, callee, arg, mode, line, parent, false};
+        }
+
+        // The input a step reads, if it is one. Its text comes from
+        // SeminalInput::render, as in the findings.
+        bool inputOf(const ProvenanceNode &step, SeminalInput &input) {
+            const string var = symbols.str(step.var);
+            switch (step.kind) {
+            case ProvenanceNode::ScanfInScope:
+                input = {SeminalInput::ScanfArgument, var, var};
+                return true;
+            case ProvenanceNode::Scanf:
+                input = {SeminalInput::ScanfResult, var, var};
+                return true;
+            case ProvenanceNode::Fopen:
+                input = {SeminalInput::Fopen, var, symbols.str(step.arg), symbols.str(step.mode)};
+                return true;
+            case ProvenanceNode::Fread:
+                input = {SeminalInput::Fread, var, symbols.str(step.arg)};
+                return true;
+            case ProvenanceNode::Getc:
+                input = {SeminalInput::Getc, var, symbols.str(step.arg)};
+                return true;
+            default:
+                return false;
             }
-            return -1;
         }
 
-        // function to find the index of function in function_calls with line=l
-        int find_function_index_in_function_calls_line(int l) {
-            for (int i = 0; i < function_calls.size(); i++) {
-                if (function_calls[i].line == l) {
-                    return i;
-                }
+        string renderStep(const ProvenanceNode &step) {
+            SeminalInput input;
+            if (inputOf(step, input)) return input.render();
+            if (step.kind == ProvenanceNode::Parameter)
+                return symbols.str(step.var) + " defined as a parameter in function " + symbols.str(step.callee);
+            return symbols.str(step.var) + " gets value from argument " + symbols.str(step.arg) + " in function call to " + symbols.str(step.callee);
+        }
+
+        vector<string> renderPath(const ProvenanceNode *tail) {
+            vector<string> lines;
+            for (const ProvenanceNode *step = tail; step; step = step->parent) {
+                lines.push_back(renderStep(*step));
             }
-            return -1;
+            std::reverse(lines.begin(), lines.end());
+            return lines;
         }
 
-        bool seminal = false;
-        vector<pair<string, string>> visited;
-        string current_branch_id = "";
+        // One do_analysis step: the variable being traced and how far its
+        // loops over parameter call sites or assignment lines have got. A
+        // frame is suspended while the walk follows one of its edges and
+        // resumed at the same position.
+        struct AnalysisFrame {
+            symbol var_name;
+            symbol scope;
+            int v;
+            bool found;
+            bool in_parameters = true;
+            bool done = false;
+            bool found_val = false;
+            size_t outer = 0;           // functions_by_line / gets_value_infos
+            bool outer_started = false;
+            size_t inner = 0;           // callers / vars_of(gl)
+            int arg_index = 0;
+            const ProvenanceNode *path = nullptr;   // the explanation so far
+        };
+
+        // Records a chain that reaches an input. Only the first one per
+        // branch variable unless -seminal-all-paths, and then not the chains
+        // that are the start of one recorded already.
+        void reportSeminal(BranchQuery &query, const ProvenanceNode *path) {
+            if (query.seminal && (!SeminalAllPaths || (path && path->reported))) return;
+            for (const ProvenanceNode *step = path; step && !step->reported; step = step->parent) {
+                step->reported = true;
+            }
+
+            SeminalFinding finding;
+            finding.branch_id = query.branch_id;
+            finding.line = query.line;
+            for (const ProvenanceNode *step = path; step; step = step->parent) {
+                SeminalInput input;
+                if (inputOf(*step, input)) finding.inputs.push_back(std::move(input));
+            }
+            std::reverse(finding.inputs.begin(), finding.inputs.end());
+            finding.path = renderPath(path);
+            query.findings.push_back(std::move(finding));
+            query.seminal = true;
+        }
 
-        void do_analysis(string var_name, string scope, vector<string> s, bool found=false) {
+        // Starts tracing var_name in scope. Pushes a frame unless the variable
+        // is visited or unknown, reads nothing that matters, or is read by a
+        // scanf in scope, which ends the walk here.
+        void enterAnalysis(BranchQuery &query, vector<AnalysisFrame> &frames, symbol var_name,
+                           symbol scope, bool found, const ProvenanceNode *path) {
             // check if we have already visited this variable in this scope
-            for (auto &v : visited) {
-                if (v.first == var_name && v.second == scope) {
-                    return;
-                }
+            if (query.visited.count(variable_key(var_name, scope))) {
+                return;
             }
             // find the variable in variable_infos
             int v = find_variable_index_in_variable_infos(var_name, scope);
             if (v == -1) {
-                // errs() << "Variable " << var_name << " not found in variable_infos\n";
                 return;
             }
             
-            var_map vm = variable_infos[v];
-            bool done = false;
+            // Nothing reachable from here reads input, so the walk below
+            // would not report anything either.
+            if (!found) {
+                int node = findVariableNode(var_name, scope);
+                if (node != -1 && !(variable_nodes[node].reaches & ReportedSources)) {
+                    markVisited(query, node);
+                    return;
+                }
+            }
 
-            visited.push_back({var_name, scope});
+            if (frames.size() >= SeminalMaxDepth || query.analysis_nodes >= SeminalMaxNodes) {
+                query.budget_exhausted = true;
+                return;
+            }
+            query.analysis_nodes++;
 
+            query.visited.insert(variable_key(var_name, scope));
 
-            for (const auto& fcall : function_calls) {
-                if (fcall.scope == scope && (fcall.name == "__isoc99_scanf" || fcall.name == "scanf")) {
+            bool done = false;
+            for (int fc : lookup_all(calls_by_scope, scope)) {
+                const func_call_map &fcall = function_calls[fc];
+                if (is_scanf(fcall.name)) {
                     // Start from index 1 since first argument is format string
                     for (size_t i = 1; i < fcall.args.size(); i++) {
-                        // errs() << "Checking if " << fcall.args[i].name << " is equal to " << var_name << "\n";
                         if (fcall.args[i].name == var_name) {
-                            string ss = "#:" + var_name + " gets value from user input via scanf";
-                            s.push_back(ss);
+                            path = addStep(query, ProvenanceNode::ScanfInScope, var_name, fcall.name, sym_none, sym_none, fcall.line, path);
                             found = true;
                             done = true;
                             break;
@@ -652,327 +1255,283 @@ namespace {
             }
 
             if (done) {
-                if (found && !seminal) {
-                    // errs() << "Branch is seminal  source code line: "<< current_line << " branch ID: "<< current_branch_id <<"\n";
-                    // for(auto &ss: s) {
-                    //     errs() << "  " << ss << "\n";
-                    // }
-                    // errs() << "\n";
-                    std::ofstream out("def-use-out.txt", std::ios_base::app);
-                    out << "Branch is seminal source code line: "<< current_line << " branch ID: "<< current_branch_id <<"\n";
-                    for(auto &ss: s) {
-                        out << "  " << ss << "\n";
-                    }
-                    out << "\n";
-                    out.close();
-                    seminal_output[current_line] = s;
-                    seminal = true;
-                }
+                if (found) reportSeminal(query, path);
                 return;
             }
-            
-            for(auto &f: functions) {
-                if(f.line_num == vm.defined_at_line) {
-                    int fci = find_function_index_in_functions(f.name);
-                    string ss = "";
-                    ss += var_name + " defined as a parameter in function " + f.name;
-                    s.push_back(ss);
-                    func_map fm = functions[fci];
-                    int arg_index = 0;
-                    for(auto &pa: fm.args) 
-                        if(pa.name == var_name) {arg_index = pa.id;}
-                    for (int i = 0; i < function_calls.size(); i++) {
-                        if (function_calls[i].name == f.name) {
-                            func_call_map fcm = function_calls[i];
-                            fcm.args[arg_index].name;    
-                            // prevent infinte recursion
-                            if(fcm.args[arg_index].name == var_name && fcm.scope == scope)
-                                continue;
-                            else{
-                                ss = "";
-                                ss += var_name + " gets value from argument " + fcm.args[arg_index].name + " in function call to " + f.name;
-                                s.push_back(ss);
-                                do_analysis(fcm.args[arg_index].name, fcm.scope, s);
-                                done = true;
-                            }
 
+            AnalysisFrame frame;
+            frame.var_name = var_name;
+            frame.scope = scope;
+            frame.v = v;
+            frame.found = found;
+            frame.path = path;
+            frames.push_back(frame);
+        }
+
+        // Traces var_name back to the inputs it gets its value from, writing
+        // the first chain that reaches one to def-use-out.txt. Walks
+        // parameters to their call sites and assigned variables to the
+        // variables on the assigning line, depth first, with an explicit
+        // stack bounded by -seminal-max-depth and -seminal-max-nodes.
+        void do_analysis(BranchQuery &query, symbol var_name, symbol scope) {
+            vector<AnalysisFrame> frames;
+            enterAnalysis(query, frames, var_name, scope, false, nullptr);
+
+            while (!frames.empty()) {
+                AnalysisFrame &frame = frames.back();
+                const symbol name = frame.var_name;
+                const var_map &vm = variable_infos[frame.v];
+
+                if (frame.in_parameters) {
+                    const vector<int> &defined_here = lookup_all(functions_by_line, line_key(vm.file, vm.defined_at_line));
+                    if (frame.outer < defined_here.size()) {
+                        const int fi = defined_here[frame.outer];
+                        const func_map &f = functions[fi];
+                        if (!frame.outer_started) {
+                            frame.outer_started = true;
+                            frame.inner = 0;
+                            frame.path = addStep(query, ProvenanceNode::Parameter, name, f.name, sym_none, sym_none, f.line_num, frame.path);
+                            frame.arg_index = 0;
+                            for(auto &pa: f.args) 
+                                if(pa.name == name) {frame.arg_index = pa.id;}
                         }
+
+                        const vector<int> &calls = callers[fi];
+                        if (frame.inner < calls.size()) {
+                            const func_call_map &fcm = function_calls[calls[frame.inner++]];
+                            if ((size_t)frame.arg_index >= fcm.args.size()) continue;
+                            const symbol arg = fcm.args[frame.arg_index].name;
+                            // prevent infinte recursion
+                            if (arg == name && fcm.scope == frame.scope) continue;
+                            frame.path = addStep(query, ProvenanceNode::Argument, name, f.name, arg, sym_none, fcm.line, frame.path);
+                            frame.done = true;
+                            enterAnalysis(query, frames, arg, fcm.scope, false, frame.path);
+                            continue;
+                        }
+
+                        frame.outer++;
+                        frame.outer_started = false;
+                        continue;
+                    }
+
+                    if (frame.done) {
+                        frames.pop_back();
+                        continue;
                     }
+                    frame.in_parameters = false;
+                    frame.outer = 0;
+                    frame.outer_started = false;
                 }
-            }
-            
-            if(done) return;
 
-            bool found_val = false;
+                // find where it gets value from
+                if (frame.outer < vm.gets_value_infos.size()) {
+                    const get_list &gl = vm.gets_value_infos[frame.outer];
+                    if (!frame.outer_started) {
+                        frame.outer_started = true;
+                        frame.inner = 0;
+
+                        // check if there is a function call on the same line, and analyze each function.
+                        for(int i : lookup_all(calls_by_line, line_key(gl.file, gl.gets_at_line))) {
+                            // check if the name is part of the input functions
+                            const func_call_map &call = function_calls[i];
+                            symbol fname = call.name;
+                            if(fname == sym_getc || fname == sym_fgetc) {
+                                frame.path = addStep(query, ProvenanceNode::Getc, name, call.name, call.args[0].name, sym_none, gl.gets_at_line, frame.path);
+                                frame.found_val = false;
+                            } else if(fname == sym_fopen) {
+                                frame.path = addStep(query, ProvenanceNode::Fopen, name, call.name, call.args[0].name, call.args[1].name, gl.gets_at_line, frame.path);
+                                frame.found_val = true;
+                            } else if(fname == sym_fread) {
+                                frame.path = addStep(query, ProvenanceNode::Fread, name, call.name, call.args[0].name, sym_none, gl.gets_at_line, frame.path);
+                                frame.found_val = true;
+                            } else if(is_scanf(fname)) {
+                                frame.path = addStep(query, ProvenanceNode::Scanf, name, call.name, sym_none, sym_none, gl.gets_at_line, frame.path);
+                                frame.found_val = true;
+                            }
+                        }
 
-            // find where it gets value from
-            for (auto &gl : vm.gets_value_infos) {
-                // errs()<<"analyzing line: "<<gl.code<<"\n";
-                
-                // check if there is a function call on the same line, and analyze each function.
-                for(int i = 0; i < function_calls.size(); i++) {
-                    if(function_calls[i].line == gl.gets_at_line) {
-                        // check if the name is part of the input functions
-                        string fname = function_calls[i].name;
-                        if(fname == "getc" || fname == "fgetc") {
-                            string ss = "";
-                            ss += "#: " + var_name + " gets value from each character in variable called " + function_calls[i].args[0].name;
-                            s.push_back(ss);
-                            found_val=false;
-                        }else if(fname == "fopen"){
-                            string ss = "";
-                            ss += "#: " + var_name + " gets value from file at path " + function_calls[i].args[0].name + " opened in mode " + function_calls[i].args[1].name;
-                            s.push_back(ss);
-                            found_val = true;
-                        } else if(fname == "fread"){
-                            string ss = "";
-                            ss += "#: " + var_name + " gets value from file buffer named " + function_calls[i].args[0].name;
-                            s.push_back(ss);
-                            found_val = true;
-                        } else if(fname == "scanf" || fname == "__isoc99_scanf"){
-                            string ss = "";
-                            ss += "#: " + var_name + " gets value from user input";
-                            s.push_back(ss);
-                            found_val = true;
+                        if (vars_of(gl).size() == 0) {
+                            frames.pop_back();
+                            continue;
                         }
                     }
-                }
-
-                if(gl.vars.vars.size() == 0){
-                    return;
-                };
 
-                for (auto &va : gl.vars.vars) {
-                    if(va.name != var_name) {
-                        // errs()<<"going to analyzing variable: "<<va.name<<"\n";
-                        do_analysis(va.name, gl.vars.scope, s, found_val);
+                    if (frame.inner < vars_of(gl).size()) {
+                        const variable &va = vars_of(gl)[frame.inner++];
+                        if (va.name != name) {
+                            enterAnalysis(query, frames, va.name, gl.scope, frame.found_val, frame.path);
+                        }
+                        continue;
                     }
+
+                    frame.outer++;
+                    frame.outer_started = false;
+                    continue;
                 }
-            }
 
-            if( (found_val || found) && !seminal ) {
-                // errs() << "Branch is seminal source code line: "<< current_line << " branch ID: "<< current_branch_id <<"\n";
-                // for(auto &ss: s) {
-                //     errs() << "  " << ss << "\n";
-                // }
-                // errs() << "\n";
-                // write contents of s to a file called def-use-out.txt (append if there is content already)
-                std::ofstream out("def-use-out.txt", std::ios_base::app);
-                out << "Branch is seminal source code line: "<< current_line << " branch ID: "<< current_branch_id <<"\n";
-                for(auto &ss: s) {
-                    out << "  " << ss << "\n";
+                if (frame.found_val || frame.found) {
+                    reportSeminal(query, frame.path);
                 }
-                out << "\n";
-                out.close();
-                seminal_output[current_line] = s;
-                seminal = true;
+                frames.pop_back();
             }
         }
 
         bool debug = false;
 
-        int current_line = 0;
-        unordered_map<int, vector<string>> seminal_output;
-
-        std::vector<std::string> analyzeSeminalBehavior(const std::string& filename) {
-    std::ifstream file(filename);
-    std::set<std::string> uniqueBehaviors;
-    std::string line;
-    bool inBranch = false;
-    std::set<std::string> fileVarsInBranch;
-    bool hasFileRead = false;
-    std::vector<std::string> branchLines;
-
-    if (!file.is_open()) {
-        return {};
-    }
-
-    while (std::getline(file, line)) {
-        // Check for new branch
-        if (line.find("Branch is seminal") != std::string::npos) {
-            // Process previous branch
-            for (const auto& fileVar : fileVarsInBranch) {
-                string mf = fileVar;
-                if(fileVar.find("opened in") != std::string::npos) {
-                    size_t pos = fileVar.find("opened in");
-                    mf = fileVar.substr(0, pos);
+        // Traces every variable on the query's line.
+        void answerQuery(BranchQuery &query) {
+            int lp = find_line_index_in_variables_per_line(query.key);
+            if (lp == -1) return;
+
+            const line_map &vp = variables_per_line[lp];
+            query.visited.clear();
+            for (const auto &va : vp.vars) {
+                query.seminal = false;
+                do_analysis(query, va.name, vp.scope);
+            }
+        }
+
+        vector<SeminalFinding> findings;
+
+        // The distinct input behaviors: every variable read by scanf, every
+        // file opened on a seminal chain, and the size of that file when the
+        // same chain also reads from a stream or buffer.
+        std::vector<std::string> summarizeSeminalBehavior() {
+            std::set<std::string> uniqueBehaviors;
+            for (const SeminalFinding &finding : findings) {
+                bool hasFileRead = false;
+                std::set<std::string> files;
+                for (const SeminalInput &input : finding.inputs) {
+                    switch (input.kind) {
+                    case SeminalInput::ScanfArgument:
+                        uniqueBehaviors.insert(input.object);
+                        break;
+                    case SeminalInput::Fopen:
+                        // Spelled as the def-use text used to be cut up, with
+                        // the space before "opened in".
+                        files.insert(input.object + " ");
+                        break;
+                    case SeminalInput::Fread:
+                    case SeminalInput::Getc:
+                        hasFileRead = true;
+                        break;
+                    case SeminalInput::ScanfResult:
+                        break;
+                    }
                 }
-                if (hasFileRead) {
-                    uniqueBehaviors.insert("size of " + mf);
+                for (const std::string &file : files) {
+                    if (hasFileRead) uniqueBehaviors.insert("size of " + file);
+                    uniqueBehaviors.insert(file);
                 }
-                uniqueBehaviors.insert(mf);
             }
-            
-            // Reset for new branch
-            inBranch = true;
-            fileVarsInBranch.clear();
-            hasFileRead = false;
-            branchLines.clear();
-            continue;
+            return std::vector<std::string>(uniqueBehaviors.begin(), uniqueBehaviors.end());
         }
 
-        // Skip if not in a branch or line is empty
-        if (!inBranch || line.empty()) continue;
-
-        // Check if line belongs to current branch (has 2 spaces at start)
-        if (line.find("  ") == 0) {
-            branchLines.push_back(line);
-
-            // Check for file read operations (gets value from file buffer OR gets value from each character)
-            if (line.find("gets value from file buffer") != std::string::npos ||
-                (line.find("#") != std::string::npos && line.find("gets value from each character") != std::string::npos)) {
-                hasFileRead = true;
-            }
-
-            // Check for scanf operations (marked with #)
-            if (line.find("#") != std::string::npos && line.find("scanf") != std::string::npos) {
-                size_t varStart = line.find(":") + 1;
-                size_t varEnd = line.find("gets") - 1;
-                if (varStart != std::string::npos && varEnd != std::string::npos) {
-                    std::string variable = line.substr(varStart, varEnd - varStart);
-                    variable = variable.substr(variable.find_first_not_of(" "), 
-                                            variable.find_last_not_of(" ") + 1);
-                    if (!variable.empty()) {
-                        uniqueBehaviors.insert(variable);
-                    }
+        void writeDefUse(const std::string &filename) {
+            std::error_code EC;
+            raw_fd_ostream out(filename, EC);
+            if (EC) {
+                errs() << "SeminalPass: cannot write " << filename << ": " << EC.message() << "\n";
+                return;
+            }
+            for (const SeminalFinding &finding : findings) {
+                out << "Branch is seminal source code line: " << finding.line << " branch ID: " << finding.branch_id << "\n";
+                for (const std::string &step : finding.path) {
+                    out << "  " << step << "\n";
                 }
+                out << "\n";
             }
+        }
 
-            // Check for file operations with path
-            if (line.find("gets value from file at path") != std::string::npos) {
-                size_t pathStart = line.find("path") + 5;
-                size_t modeStart = line.find("mode") - 1;
-                if (pathStart != std::string::npos && modeStart != std::string::npos) {
-                    std::string filepath = line.substr(pathStart, modeStart - pathStart);
-                    filepath = filepath.substr(filepath.find_first_not_of(" "), 
-                                            filepath.find_last_not_of(" ") + 1);
-                    if (!filepath.empty() && filepath != "\"rb\"" && filepath != "\"wb\"") {
-                        fileVarsInBranch.insert(filepath);
-                    }
+        // Tags the conditional branches on seminal lines with !seminal so a
+        // later SkeletonPass can instrument only those (-skeleton-select).
+        void markSeminalBranches(Module &M, const vector<BranchLine> &targets) {
+            LLVMContext &context = M.getContext();
+            std::set<string> seminal_ids;
+            for (const SeminalFinding &finding : findings) {
+                seminal_ids.insert(finding.branch_id);
+            }
+            for (const BranchLine &target : targets) {
+                if (!seminal_ids.count(target.branch_id)) continue;
+                for (BranchInst *BI : target.branches) {
+                    BI->setMetadata("seminal", MDNode::get(context, {}));
                 }
             }
-        } else {
-            // Process the branch before moving to next
-            for (const auto& fileVar : fileVarsInBranch) {
-                string mf = fileVar;
-                if(fileVar.find("opened in") != std::string::npos) {
-                    size_t pos = fileVar.find("opened in");
-                    mf = fileVar.substr(0, pos);
+            M.getOrInsertNamedMetadata("seminal.analyzed");
+        }
+
+        // -seminal-engine=ssa: one finding per branch line whose conditions
+        // reach an input through the IR, with the inputs as its path.
+        void analyzeWithSSA(Module &M, ModuleAnalysisManager &AM, const vector<BranchLine> &targets) {
+            FunctionAnalysisManager &FAM =
+                AM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+
+            SSADefUse engine(M, FAM, SeminalMaxNodes);
+            for (const BranchLine &target : targets) {
+                bool exhausted = false;
+                std::vector<SeminalInput> inputs = engine.inputsOf(target.branches, exhausted);
+                if (exhausted) {
+                    errs() << "SeminalPass: analysis budget exhausted for line " << target.key.line << " ("
+                           << target.branch_id << "), results for it may be incomplete\n";
                 }
-                if (hasFileRead) {
-                    uniqueBehaviors.insert("size of " + mf);
+                if (inputs.empty()) continue;
+
+                SeminalFinding finding{target.branch_id, (int)target.key.line, inputs, {}};
+                for (const SeminalInput &input : inputs) {
+                    finding.path.push_back(input.render());
                 }
-                uniqueBehaviors.insert(mf);
+                findings.push_back(std::move(finding));
             }
-            inBranch = false;
-            branchLines.clear();
         }
-    }
 
-    // Process the last branch if exists
-    if (inBranch) {
-        for (const auto& fileVar : fileVarsInBranch) {
-            string mf = fileVar;
-            if(fileVar.find("opened in") != std::string::npos) {
-                size_t pos = fileVar.find("opened in");
-                mf = fileVar.substr(0, pos);
-            }
-            if (hasFileRead) {
-                uniqueBehaviors.insert("size of " + mf);
+        PreservedAnalyses reportFindings(Module &M, const vector<BranchLine> &targets) {
+            markSeminalBranches(M, targets);
+            writeDefUse("def-use-out.txt");
+
+            vector<string> uniqueBehaviors = summarizeSeminalBehavior();
+            // print unique behaviors
+            errs() << "Final seminal behavior:\n";
+            for (const std::string& behavior : uniqueBehaviors) {
+                errs() << "  " << behavior << "\n";
             }
-            uniqueBehaviors.insert(mf);
-        }
-    }
 
-    return std::vector<std::string>(uniqueBehaviors.begin(), uniqueBehaviors.end());
-}
+            return PreservedAnalyses::all();
+        }
 
     public:
         PreservedAnalyses run(Module &M, ModuleAnalysisManager &AM) {
+            vector<BranchLine> targets = readBranchInfo(M, AM);
+            if (SeminalEngine == SeminalEngineKind::SSA) {
+                analyzeWithSSA(M, AM, targets);
+                return reportFindings(M, targets);
+            }
 
-            std::ofstream file("def-use-out.txt", std::ofstream::out | std::ofstream::trunc);
-            file.close();
              // Track global variables first
             trackGlobalVariables(M);
-
-            for(unsigned int ii=0; ii<1000; ii++) loop_map[ii] = 0;
-            
-            vector<pair<int, string>> ttt = readBranchInfo();
             // targetLines = readBranchInfo();
 
+            std::vector<Function*> defined;
             for (Function &F : M) {
-                if (F.isDeclaration())
-                    continue;
-
-                FunctionAnalysisManager &FAM = 
-                    AM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
-                LoopInfo &LI = FAM.getResult<LoopAnalysis>(F);
-                    
-                for (BasicBlock &BB : F) {
-                    for (Instruction &I : BB) {
-                        getVariableNamesAtLine(I, F, LI);
-                    }
-                }
+                if (!F.isDeclaration()) defined.push_back(&F);
             }
 
-            for (const auto& lineEntry : lineToVars) {
-                line_map lm;
-                lm.line_num = lineEntry.first;
-                lm.vars = std::vector<variable>();
-                if (!lineEntry.second.empty()) {
-                    for (const auto &varName : lineEntry.second) 
-                        lm.vars.push_back({varName});
-                }
-                lm.part_of_loop = loop_map[lm.line_num];
-                variables_per_line.push_back(lm);
+            std::vector<FactShard> shards(defined.size());
+            runParallel(defined.size(), [&](size_t i) { collectLineFacts(shards[i], *defined[i]); });
+            for (size_t i = 0; i < defined.size(); ++i) {
+                mergeLineFacts(*defined[i], shards[i]);
             }
+
+            buildLineTable();
     
             // First analyze global variables
             analyzeGlobalVariables(M);
             
             // Second pass: Function trace analysis
-            for (Function& F : M) {
-                if (!F.isDeclaration()) {
-                    printFunctionHeader(F);
-                    
-                    for (BasicBlock& BB : F) {
-                        for (Instruction& I : BB) {
-                            processInstruction(&I);
-                        }
-                    }
-                }
-            }
-
-            vector<pair<int, string>> scope_map;
-            for (auto &f: functions) {
-                if (f.name.empty()) continue;  // Skip if name is empty
-                scope_map.push_back({f.line_num, f.name});
-            }
-
-            // Sort scope_map by line numbers to ensure proper ordering
-            std::sort(scope_map.begin(), scope_map.end());
-
-            if (!scope_map.empty()) {  // Only proceed if we have valid scopes
-                int minn = scope_map[0].first;
-                int maxx = scope_map[scope_map.size()-1].first;
-                
-                for (int v = 0; v < variables_per_line.size(); v++) {
-                    line_map &current_line = variables_per_line[v];
-                    int ln = current_line.line_num;
-                    
-                    // Default to global scope
-                    current_line.scope = "global";
-                    
-                    // Find appropriate scope
-                    for (size_t i = 0; i < scope_map.size(); i++) {
-                        if (ln >= scope_map[i].first && 
-                            (i == scope_map.size()-1 || ln < scope_map[i+1].first)) {
-                            current_line.scope = scope_map[i].second;
-                            break;
-                        }
-                    }
-                }
+            runParallel(defined.size(), [&](size_t i) { collectFunctionFacts(shards[i], *defined[i]); });
+            for (FactShard &shard : shards) {
+                mergeFunctionFacts(shard);
             }
+            buildCallerIndex(M, AM);
 
             if(debug){
                 errs() << "Variable Trace Analysis\n";
@@ -980,12 +1539,17 @@ namespace {
                 errs() << "Variables defined at each line\n";
 
                 // print variables per line
-                for (auto &vp : variables_per_line) {
+                for (size_t lp = 0; lp < variables_per_line.size(); ++lp) {
+                    const line_map &vp = variables_per_line[lp];
                     errs() << "Line: " << vp.line_num << "\n";
                     errs() << "  Part of Loop: " << vp.part_of_loop << "\n";
-                    errs() << "  Scope: " << vp.scope << "\n";
+                    if (vp.part_of_loop) {
+                        const LoopLine &loop_line = line_loops[lp];
+                        errs() << "  Loop depth " << loop_line.depth << ", lines " << loop_line.loop_start << "-" << loop_line.loop_end << "\n";
+                    }
+                    errs() << "  Scope: " << symbols.name(vp.scope) << "\n";
                     for (auto &va : vp.vars) {
-                        errs() << "  Variable: " << va.name << "\n";
+                        errs() << "  Variable: " << symbols.name(va.name) << "\n";
                     }
                 }
 
@@ -994,9 +1558,9 @@ namespace {
 
                 // print function info
                 for (auto &fi : functions) {
-                    errs() << "Function: " << fi.name << " defined at line " << fi.line_num << "\n";
+                    errs() << "Function: " << symbols.name(fi.name) << " defined at line " << fi.line_num << "\n";
                     for (auto &pa : fi.args) {
-                        errs() << "  Argument: " << pa.name << " at position " << pa.id << "\n";
+                        errs() << "  Argument: " << symbols.name(pa.name) << " at position " << pa.id << "\n";
                     }
                 }
 
@@ -1005,12 +1569,12 @@ namespace {
 
                 // print variable info
                 for (auto &vi : variable_infos) {
-                    errs() << "Variable: " << vi.name << " defined at line " << vi.defined_at_line << " with scope: "<<vi.scope << "\n";
+                    errs() << "Variable: " << symbols.name(vi.name) << " defined at line " << vi.defined_at_line << " with scope: "<< symbols.name(vi.scope) << "\n";
                     for (auto &gl : vi.gets_value_infos) {
-                        errs() << "  Gets value at line " << gl.gets_at_line << " with type " << gl.type << " and code " << gl.code << "\n";
+                        errs() << "  Gets value at line " << gl.gets_at_line << " with type " << get_type_name(gl.type) << " and code " << gl.code << "\n";
                         errs() << "    Variables on this line: \n";
-                        for (auto &va : gl.vars.vars) {
-                            errs() << "      " << va.name << " scope: "<<gl.vars.scope << "\n";
+                        for (auto &va : vars_of(gl)) {
+                            errs() << "      " << symbols.name(va.name) << " scope: "<< symbols.name(gl.scope) << "\n";
                         }
                     }
                 }
@@ -1020,48 +1584,53 @@ namespace {
 
                 // print function call info
                 for (auto &fci : function_calls) {
-                    errs() << "Function call: " << fci.name << " at line " << fci.line << " with scope: "<<fci.scope << "\n";
+                    errs() << "Function call: " << symbols.name(fci.name) << " at line " << fci.line << " with scope: "<< symbols.name(fci.scope) << "\n";
                     for (auto &pa : fci.args) {
-                        errs() << "  Argument: " << pa.name << " at position " << pa.id << "\n";
+                        errs() << "  Argument: " << symbols.name(pa.name) << " at position " << pa.id << "\n";
                     }
                 }
                 
                 errs() << "\n\n\n";
             }
 
-            for (auto tt : ttt) {
-                int tl = tt.first;
-                string branch_id = tt.second;
-                // find variables per line on line tl
-                current_line = tl;
-                current_branch_id = branch_id;
-                // errs() << "Analyzing line: " << tl << " branch ID: "<< branch_id << "\n";
-                // if(loop_map[tl] == 0) continue;
-                seminal_output[tl] = vector<string>();
-                for (auto &vp : variables_per_line) {
-                    visited.clear();
-                    if(vp.line_num == tl) {
-                        for (auto va : vp.vars) {
-                            seminal = false;
-                            vector<string> s;
-                            do_analysis(va.name, vp.scope, s);
-                        }
-                    }
-                }
+            std::vector<BranchQuery> queries(targets.size());
+            for (size_t i = 0; i < targets.size(); ++i) {
+                queries[i].key = targets[i].key;
+                queries[i].line = targets[i].key.line;
+                queries[i].branch_id = targets[i].branch_id;
+                int lp = find_line_index_in_variables_per_line(queries[i].key);
+                if (lp != -1) prepareVariableNodes(variables_per_line[lp]);
             }
 
-            // call analyzeSeminalBehavior
-            vector<string> uniqueBehaviors = analyzeSeminalBehavior("def-use-out.txt");
-            // print unique behaviors
-            errs() << "Final seminal behavior:\n";
-            for (const std::string& behavior : uniqueBehaviors) {
-                errs() << "  " << behavior << "\n";
+            runParallel(queries.size(), [&](size_t i) { answerQuery(queries[i]); });
+
+            // Merged in query order, which is line order, as a serial run
+            // reports them.
+            for (BranchQuery &query : queries) {
+                if (query.budget_exhausted) {
+                    errs() << "SeminalPass: analysis budget exhausted for line " << query.line << " ("
+                           << query.branch_id << "), results for it may be incomplete\n";
+                }
+                std::move(query.findings.begin(), query.findings.end(), std::back_inserter(findings));
             }
-            
-            
-            return PreservedAnalyses::all();
+
+            return reportFindings(M, targets);
         }
     };
+
+    struct SeminalPass : public PassInfoMixin<SeminalPass> {
+        PreservedAnalyses run(Module &M, ModuleAnalysisManager &AM) {
+            return SeminalAnalysis().run(M, AM);
+        }
+    };
+}
+
+void registerSeminalPass(PassBuilder &PB) {
+    registerBranchInfoAnalysis(PB);
+    PB.registerPipelineStartEPCallback(
+        [](ModulePassManager &MPM, OptimizationLevel Level) {
+            MPM.addPass(SeminalPass());
+        });
 }
 
 extern "C" LLVM_ATTRIBUTE_WEAK ::llvm::PassPluginLibraryInfo
@@ -1070,11 +1639,6 @@ llvmGetPassPluginInfo() {
         .APIVersion = LLVM_PLUGIN_API_VERSION,
         .PluginName = "Variable Trace Pass",
         .PluginVersion = "v0.1",
-        .RegisterPassBuilderCallbacks = [](PassBuilder &PB) {
-            PB.registerPipelineStartEPCallback(
-                [](ModulePassManager &MPM, OptimizationLevel Level) {
-                    MPM.addPass(SeminalPass());
-                });
-        }
+        .RegisterPassBuilderCallbacks = registerSeminalPass
     };
 }
\ No newline at end of file
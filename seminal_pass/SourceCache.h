@@ -0,0 +1,64 @@
+#ifndef SEMINAL_SOURCE_CACHE_H
+#define SEMINAL_SOURCE_CACHE_H
+
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Source files the pass has looked at, each read (or mapped) once together
+// with the offset of every line, so a line lookup is an index instead of a
+// re-read of the file up to that line. Safe to share between threads: files
+// are added under a lock and never moved or dropped until clear().
+class SourceCache {
+public:
+    // Line `line` (1-based) of `path` without its newline, or None if the
+    // file can't be read or is shorter than that.
+    llvm::Optional<llvm::StringRef> getLine(llvm::StringRef path, unsigned line) {
+        const File &file = getFile(path);
+        if (!file.buffer || line == 0 || line > file.line_starts.size())
+            return llvm::None;
+
+        llvm::StringRef text = file.buffer->getBuffer();
+        size_t start = file.line_starts[line - 1];
+        size_t end = line < file.line_starts.size() ? file.line_starts[line] - 1 : text.size();
+        return text.slice(start, end);
+    }
+
+    void clear() { files.clear(); }
+
+private:
+    struct File {
+        std::unique_ptr<llvm::MemoryBuffer> buffer;
+        std::vector<size_t> line_starts;
+    };
+
+    const File &getFile(llvm::StringRef path) {
+        std::lock_guard<std::mutex> guard(*lock);
+        auto inserted = files.try_emplace(path);
+        File &file = inserted.first->second;
+        if (!inserted.second) return file;
+
+        // Files that can't be opened are remembered as empty entries too.
+        auto buffer = llvm::MemoryBuffer::getFile(path, /*IsText=*/false,
+                                                  /*RequiresNullTerminator=*/false);
+        if (!buffer) return file;
+        file.buffer = std::move(*buffer);
+
+        llvm::StringRef text = file.buffer->getBuffer();
+        if (!text.empty()) file.line_starts.push_back(0);
+        for (size_t i = 0; i < text.size(); ++i) {
+            if (text[i] == '\n' && i + 1 < text.size()) file.line_starts.push_back(i + 1);
+        }
+        return file;
+    }
+
+    llvm::StringMap<File> files;
+    std::unique_ptr<std::mutex> lock = std::make_unique<std::mutex>();  // keeps the cache movable
+};
+
+#endif
@@ -1,3 +1,6 @@
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Allocator.h"
 #include "llvm/Pass.h"
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Passes/PassPlugin.h"
@@ -8,61 +11,218 @@
 #include "llvm/IR/DebugInfoMetadata.h"
 #include "llvm/IR/GetElementPtrTypeIterator.h"
 
+#include <cstdint>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <set>
 #include <fstream>
 #include <vector>
 #include <sstream>
+#include <unordered_map>
 
 using namespace std;
 
+// Interned name: a dense id handed out by SymbolTable. Facts store and
+// compare these, the text is looked up only for output.
+typedef unsigned symbol;
+
+// Names every module has, interned first so their ids are constants.
+enum : symbol {
+    sym_none,               // ""
+    sym_global,
+    sym_unknown,
+    sym_scanf,
+    sym_isoc99_scanf,
+    sym_getc,
+    sym_fgetc,
+    sym_fopen,
+    sym_fread,
+};
+
+// The names of one module. intern() and name() may be called from several
+// threads; names live as long as the table.
+class SymbolTable {
+public:
+    SymbolTable() {
+        for (const char *name : {"", "global", "unknown", "scanf", "__isoc99_scanf", "getc", "fgetc", "fopen", "fread"})
+            intern(name);
+    }
+
+    symbol intern(llvm::StringRef name) {
+        std::lock_guard<std::mutex> guard(lock);
+        auto inserted = ids.try_emplace(name, (symbol)names.size());
+        if (inserted.second) names.push_back(inserted.first->getKey());
+        return inserted.first->second;
+    }
+
+    llvm::StringRef name(symbol id) const {
+        std::lock_guard<std::mutex> guard(lock);
+        return names[id];
+    }
+
+    string str(symbol id) const { return name(id).str(); }
+
+private:
+    llvm::StringMap<symbol> ids;
+    vector<llvm::StringRef> names;
+    mutable std::mutex lock;
+};
+
+inline bool is_scanf(symbol name) {
+    return name == sym_scanf || name == sym_isoc99_scanf;
+}
+
 typedef struct {
     int id;
-    string name;
+    symbol name;
 } param;
 
 typedef struct {
-    string name;
+    symbol name;
 } variable;
 
+// The array members of the records below are written once and live in an
+// arena owned by SeminalFacts (see copy_array).
+
 typedef struct {
+    symbol file;
     int line_num;
-    string name;
-    vector<param> args;
+    symbol name;
+    llvm::ArrayRef<param> args;
 } func_map;
 
 typedef struct {
+    symbol file;
     int line_num;
-    vector<variable> vars;
-    string scope;
+    llvm::ArrayRef<variable> vars;
+    symbol scope;
     int part_of_loop;
 } line_map;
 
+// How a variable gets its value on a line: from a call on that line, as a
+// parameter, or from the other variables there.
+enum get_type { get_var, get_func, get_param };
+
+inline const char *get_type_name(get_type type) {
+    switch (type) {
+    case get_func: return "func";
+    case get_param: return "param";
+    case get_var: break;
+    }
+    return "var";
+}
+
+// `line` is the index of the assigning line in variables_per_line, whose
+// variables the value comes from, and `scope` the function the assignment is
+// in. `code` points into the cached source file.
 typedef struct {
+    symbol file;
     int gets_at_line;
-    string type;
-    string code;
-    line_map vars;
+    get_type type;
+    llvm::StringRef code;
+    int line;
+    symbol scope;
 } get_list;
 
 typedef struct {
-    string name;
-    string scope;
+    symbol name;
+    symbol scope;
+    symbol file;
     int defined_at_line;
     vector<get_list> gets_value_infos;
 } var_map;
 
 typedef struct {
-    string name;
-    vector<param> args;
-    string scope;
+    symbol name;
+    llvm::ArrayRef<param> args;
+    symbol scope;
+    symbol file;
     int line;
 } func_call_map;
 
-vector<line_map> variables_per_line;    // Variables defined at each line
-vector<func_map> functions;             // Functions and their arguments
-vector<var_map> variable_infos;              // Variables and their gets
-vector<func_call_map> function_calls;   // Function calls and their arguments
+inline uint64_t variable_key(symbol name, symbol scope) {
+    return (uint64_t)name << 32 | scope;
+}
+
+// A source line of one file, so lines of different files of a module (or of
+// headers) are kept apart.
+inline uint64_t line_key(symbol file, int line) {
+    return (uint64_t)file << 32 | (uint32_t)line;
+}
+
+// Tables of facts about one module, with indexes over them kept up to date by
+// the add_* functions. Single valued indexes hold the first entry with that
+// key, the vector valued ones every entry in table order. SeminalPass builds
+// one per module run and drops it afterwards.
+struct SeminalFacts {
+    vector<line_map> variables_per_line;    // Variables defined at each line
+    vector<func_map> functions;             // Functions and their arguments
+    vector<var_map> variable_infos;              // Variables and their gets
+    vector<func_call_map> function_calls;   // Function calls and their arguments
+
+    SymbolTable symbols;
+
+    // Backing store of the records' arrays: one arena for the tables built
+    // here, and the arenas of the per-function shards merged into them.
+    llvm::BumpPtrAllocator arena;
+    vector<std::unique_ptr<llvm::BumpPtrAllocator>> shard_arenas;
+
+    unordered_map<uint64_t, int> variable_index;              // variable_key(name, scope)
+    unordered_map<symbol, int> function_index;                // name
+    unordered_map<uint64_t, vector<int>> functions_by_line;   // line_key(file, line_num)
+    unordered_map<symbol, vector<int>> calls_by_name;         // name
+    unordered_map<uint64_t, vector<int>> calls_by_line;       // line_key(file, line)
+    unordered_map<symbol, vector<int>> calls_by_scope;        // scope
+    vector<vector<int>> callers;                              // function index -> its calls
+
+    void add_variable_info(const var_map &vm) {
+        variable_index.insert({variable_key(vm.name, vm.scope), (int)variable_infos.size()});
+        variable_infos.push_back(vm);
+    }
+
+    void add_line(const line_map &lm) {
+        variables_per_line.push_back(lm);
+    }
+
+    void add_function(const func_map &fm) {
+        function_index.insert({fm.name, (int)functions.size()});
+        functions_by_line[line_key(fm.file, fm.line_num)].push_back(functions.size());
+        functions.push_back(fm);
+    }
+
+    void add_function_call(const func_call_map &fcm) {
+        int i = function_calls.size();
+        calls_by_name[fcm.name].push_back(i);
+        calls_by_line[line_key(fcm.file, fcm.line)].push_back(i);
+        calls_by_scope[fcm.scope].push_back(i);
+        function_calls.push_back(fcm);
+    }
+
+    // Copies `items` into `arena` for a record to point at.
+    template <typename T>
+    static llvm::ArrayRef<T> copy_array(llvm::BumpPtrAllocator &arena, llvm::ArrayRef<T> items) {
+        if (items.empty()) return {};
+        T *copy = arena.Allocate<T>(items.size());
+        std::uninitialized_copy(items.begin(), items.end(), copy);
+        return {copy, items.size()};
+    }
+
+    // The variables on the line a value is assigned on.
+    llvm::ArrayRef<variable> vars_of(const get_list &gl) const {
+        return gl.line == -1 ? llvm::ArrayRef<variable>() : variables_per_line[gl.line].vars;
+    }
+
+    // Index lists for keys that were never added.
+    static const vector<int> &no_entries() {
+        static const vector<int> empty;
+        return empty;
+    }
 
-vector<string> input_functions = {"scanf", "fread", "fopen", "getc"};
\ No newline at end of file
+    template <typename Key>
+    static const vector<int> &lookup_all(const unordered_map<Key, vector<int>> &index, Key key) {
+        auto it = index.find(key);
+        return it == index.end() ? no_entries() : it->second;
+    }
+};
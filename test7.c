@@ -0,0 +1,32 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+// Calls exit() two frames deep, from inside loops, so walk and main are
+// still running when the branch counts are written.
+
+void check(int sum, int limit) {
+    if (sum >= limit) {
+        printf("limit %d reached\n", limit);
+        exit(0);
+    }
+}
+
+int walk(int n, int limit) {
+    int sum = 0;
+    for (int i = 0; i < n; i++) {
+        if (i % 3 == 0)
+            sum += i;
+        check(sum, limit);
+    }
+    return sum;
+}
+
+int main() {
+    int n, limit;
+    scanf("%d %d", &n, &limit);
+    for (int round = 0; round < 3; round++) {
+        if (walk(n, limit) > limit / 2)
+            printf("round %d\n", round);
+    }
+    return 0;
+}
@@ -0,0 +1,193 @@
+#include <elf.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "trace_format.h"
+
+// Turns a binary trace written with BRANCH_TRACE_FILE back into the text that
+// LogBranch/LogPointer print in the default mode:
+//
+//   $ ./trace_decode trace.bin          # same lines as the old stdout output
+//   $ ./trace_decode -t trace.bin       # prefix each line with its thread
+//   $ ./trace_decode -b a.out trace.bin # add source locations from a.out
+
+// Branch ids from the __branch_info section, sorted by id once loaded.
+struct branch_location {
+    uint32_t branch_id;
+    uint32_t src_line;
+    uint32_t dest_line;
+    const char *file;
+    const char *function;
+};
+
+static struct branch_location *locations;
+static size_t num_locations, max_locations;
+
+static void add_location(const struct branch_info_record *record, const char *strings) {
+    if (num_locations == max_locations) {
+        max_locations = max_locations ? 2 * max_locations : 1024;
+        locations = realloc(locations, max_locations * sizeof(*locations));
+    }
+    struct branch_location *location = &locations[num_locations++];
+    location->branch_id = record->branch_id;
+    location->src_line = record->src_line;
+    location->dest_line = record->dest_line;
+    location->file = strings + record->file;
+    location->function = strings + record->function;
+}
+
+// A string offset is usable if the NUL that ends it is inside the blob.
+static int valid_string(const char *strings, size_t size, uint32_t offset) {
+    return offset < size && memchr(strings + offset, '\0', size - offset) != NULL;
+}
+
+static int compare_locations(const void *a, const void *b) {
+    uint32_t x = ((const struct branch_location *)a)->branch_id;
+    uint32_t y = ((const struct branch_location *)b)->branch_id;
+    return x < y ? -1 : x > y;
+}
+
+// Sorts the table and drops all but the first of any duplicate ids, which
+// come from objects built with -branch-ids=sequential or from a hash clash.
+static void sort_locations(void) {
+    qsort(locations, num_locations, sizeof(*locations), compare_locations);
+    size_t kept = 0;
+    for (size_t i = 0; i < num_locations; i++) {
+        if (kept && locations[kept - 1].branch_id == locations[i].branch_id) {
+            fprintf(stderr, "Warning: br_%u is defined by more than one object\n", locations[i].branch_id);
+            continue;
+        }
+        locations[kept++] = locations[i];
+    }
+    num_locations = kept;
+}
+
+static const struct branch_location *find_location(uint32_t branch_id) {
+    struct branch_location key = {.branch_id = branch_id};
+    return bsearch(&key, locations, num_locations, sizeof(*locations), compare_locations);
+}
+
+// Maps `path` and walks the per object blobs of its __branch_info section.
+// The mapping is kept for the lifetime of the process since the locations
+// point into it.
+static int load_branch_info(const char *path) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "Error: Could not open %s\n", path);
+        return -1;
+    }
+    const char *image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) {
+        fprintf(stderr, "Error: Could not map %s\n", path);
+        return -1;
+    }
+
+    const Elf64_Ehdr *ehdr = (const Elf64_Ehdr *)image;
+    if ((size_t)st.st_size < sizeof(*ehdr) || memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0 ||
+        ehdr->e_ident[EI_CLASS] != ELFCLASS64) {
+        fprintf(stderr, "Error: %s is not a 64-bit ELF file\n", path);
+        return -1;
+    }
+    const Elf64_Shdr *sections = (const Elf64_Shdr *)(image + ehdr->e_shoff);
+    const char *names = image + sections[ehdr->e_shstrndx].sh_offset;
+
+    for (int i = 0; i < ehdr->e_shnum; i++) {
+        if (strcmp(names + sections[i].sh_name, BRANCH_INFO_SECTION) != 0) continue;
+
+        const char *data = image + sections[i].sh_offset;
+        const char *end = data + sections[i].sh_size;
+        while (data + sizeof(struct branch_info_header) <= end) {
+            const struct branch_info_header *header = (const struct branch_info_header *)data;
+            // The linker may pad between blobs.
+            if (memcmp(header->magic, BRANCH_INFO_MAGIC, sizeof(header->magic)) != 0) {
+                data += 8;
+                continue;
+            }
+            uint64_t strings_start = sizeof(*header) + (uint64_t)header->num_records * sizeof(struct branch_info_record);
+            if (header->version != BRANCH_INFO_VERSION ||
+                header->record_size != sizeof(struct branch_info_record) ||
+                header->size > (size_t)(end - data) || strings_start > header->size) {
+                fprintf(stderr, "Error: %s has a malformed %s section\n", path, BRANCH_INFO_SECTION);
+                return -1;
+            }
+            const struct branch_info_record *records = (const struct branch_info_record *)(header + 1);
+            const char *strings = data + strings_start;
+            size_t strings_size = header->size - strings_start;
+            for (uint32_t r = 0; r < header->num_records; r++) {
+                if (!valid_string(strings, strings_size, records[r].file) ||
+                    !valid_string(strings, strings_size, records[r].function)) {
+                    fprintf(stderr, "Error: %s has a malformed %s section\n", path, BRANCH_INFO_SECTION);
+                    return -1;
+                }
+                add_location(&records[r], strings);
+            }
+            data += header->size;
+        }
+        sort_locations();
+        return 0;
+    }
+
+    fprintf(stderr, "Error: %s has no %s section\n", path, BRANCH_INFO_SECTION);
+    return -1;
+}
+
+int main(int argc, char **argv) {
+    int show_thread = 0;
+    const char *path = NULL;
+    const char *binary = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0) show_thread = 1;
+        else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) binary = argv[++i];
+        else path = argv[i];
+    }
+
+    if (!path) {
+        fprintf(stderr, "usage: %s [-t] [-b <binary>] <trace file>\n", argv[0]);
+        return 1;
+    }
+
+    if (binary && load_branch_info(binary) != 0) return 1;
+
+    FILE *in = fopen(path, "rb");
+    if (!in) {
+        fprintf(stderr, "Error: Could not open %s\n", path);
+        return 1;
+    }
+
+    struct branch_trace_header header;
+    if (fread(&header, sizeof(header), 1, in) != 1 ||
+        memcmp(header.magic, BRANCH_TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.record_size != sizeof(struct branch_trace_record)) {
+        fprintf(stderr, "Error: %s is not a branch trace\n", path);
+        fclose(in);
+        return 1;
+    }
+
+    struct branch_trace_record records[4096];
+    const struct branch_location *location;
+    size_t n;
+    while ((n = fread(records, sizeof(records[0]), 4096, in)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            if (show_thread) printf("[%u] ", records[i].thread_id);
+            if (records[i].branch_id == 0)
+                printf("*funcptr_%p\n", (void*)(uintptr_t)records[i].pointer);
+            else if ((location = find_location(records[i].branch_id))) {
+                printf("br_%d %s:%u -> %u (%s)\n", (int)records[i].branch_id, location->file,
+                       location->src_line, location->dest_line, location->function);
+            } else
+                printf("br_%d\n", (int)records[i].branch_id);
+        }
+    }
+
+    fclose(in);
+    return 0;
+}
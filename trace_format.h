@@ -0,0 +1,62 @@
+#ifndef BRANCH_TRACE_FORMAT_H
+#define BRANCH_TRACE_FORMAT_H
+
+#include <stdint.h>
+
+// On-disk layout of the binary branch trace written by logger.c when
+// BRANCH_TRACE_FILE is set, and read back by trace_decode.c.
+//
+// The file starts with one branch_trace_header followed by a stream of
+// fixed-width branch_trace_record entries. Every thread fills its own buffer
+// and appends it to the file as one block, so records from different threads
+// are grouped by block rather than interleaved one by one.
+
+#define BRANCH_TRACE_MAGIC "BRTRACE1"
+#define BRANCH_TRACE_VERSION 1
+
+struct branch_trace_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+};
+
+// branch_id == 0 marks a LogPointer record, anything else is a LogBranch.
+struct branch_trace_record {
+    uint32_t branch_id;
+    uint32_t thread_id;
+    uint64_t pointer;
+};
+
+// Branch table emitted by SkeletonPass into the __branch_info section of
+// every instrumented object. The linker concatenates the per object blobs, so
+// the section of a binary is a sequence of
+//
+//   branch_info_header | num_records * branch_info_record | string table
+//
+// each padded to a multiple of 8 bytes (header.size covers the padding). file
+// and function are offsets into the blob's own string table.
+
+#define BRANCH_INFO_SECTION "__branch_info"
+#define BRANCH_INFO_MAGIC "BRINFO1"
+#define BRANCH_INFO_VERSION 1
+
+#define BRANCH_INFO_UNINSTRUMENTED 1
+
+struct branch_info_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t num_records;
+    uint32_t size;
+};
+
+struct branch_info_record {
+    uint32_t branch_id;
+    uint32_t file;
+    uint32_t function;
+    uint32_t src_line;
+    uint32_t dest_line;
+    uint32_t flags;
+};
+
+#endif